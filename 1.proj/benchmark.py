@@ -0,0 +1,330 @@
+"""
+File: benchmark.py (for Pipeline Merge Sort)
+Author: Filip Jahn (xjahnf00)
+Subject: PRL
+Date: 16.10.2026
+
+Scaling benchmark of pms.cpp. For every size N = 2^k and key distribution the script
+generates one input file, sorts it with the single-process baseline (-e serial,
+std::stable_sort) and with every configuration of the sweep, checks that the output
+is the same as the output of the baseline and writes one JSON line per run.
+
+Usage:
+    python3 benchmark.py                                  # N = 2^10 .. 2^30, all distributions
+    python3 benchmark.py --max-exp 20 --chunks 1024,65536 --engines pipeline,sample,threads
+    python3 benchmark.py --mpirun-args="--oversubscribe --allow-run-as-root"
+    python3 benchmark.py --compare old.jsonl new.jsonl    # speedups between two builds
+
+Every result line contains the configuration (type, distribution, N, engine, processes,
+chunk, window, presort), the median and minimum wall time of the repetitions, elements
+per second, the speedup over the baseline and (with the traced build) the per-stage
+times of one extra run: total, time blocked in receiving and sending, and the rest
+(work) for every stage. Lines with the same "config" can be compared between builds.
+"""
+
+import argparse
+import datetime
+import filecmp
+import json
+import math
+import os
+import platform
+import shutil
+import statistics
+import subprocess
+import sys
+import tempfile
+import time
+from array import array
+
+SOURCE = os.path.join(os.path.dirname(os.path.abspath(__file__)), "pms.cpp")
+
+# Size of one element and the array typecode used to reverse the elements of every type
+TYPES = {
+    "u8": (1, "B"),
+    "i32": (4, "i"),
+    "u32": (4, "I"),
+    "i64": (8, "q"),
+    "u64": (8, "Q"),
+    "f64": (8, "d"),
+    "kv": (16, "Q"),
+}
+
+DISTRIBUTIONS = ["random", "sorted", "reverse", "duplicates"]
+
+# Number of distinct keys in the "duplicates" distribution
+DUPLICATE_KEYS = 16
+
+# Inputs are generated in blocks of this many elements
+GENERATE_BLOCK = 1 << 20
+
+
+def parse_list(text, convert=str):
+    return [convert(item) for item in text.split(",") if item]
+
+
+def parse_arguments():
+    parser = argparse.ArgumentParser(description="Scaling benchmark of the pipeline merge sort.")
+    parser.add_argument("--min-exp", type=int, default=10, help="smallest size 2^k (default 10)")
+    parser.add_argument("--max-exp", type=int, default=30, help="largest size 2^k (default 30)")
+    parser.add_argument("--exp-step", type=int, default=2, help="step of k (default 2)")
+    parser.add_argument("--types", default="u32", help="element types, e.g. u8,u32,kv (default u32)")
+    parser.add_argument("--distributions", default=",".join(DISTRIBUTIONS),
+                        help="random,sorted,reverse,duplicates (default all)")
+    parser.add_argument("--engines", default="pipeline,sample",
+                        help="pipeline, sample and/or threads (default pipeline,sample)")
+    parser.add_argument("--chunks", default="4096,65536",
+                        help="-b values of the sweep, 0 = one message per element (default 4096,65536)")
+    parser.add_argument("--windows", default="2", help="-w values of the sweep (default 2)")
+    parser.add_argument("--presort", default="0", help="-r values of the sweep (default 0)")
+    parser.add_argument("--sample-procs", type=int, default=4,
+                        help="processes of the sample sort engine (default 4)")
+    parser.add_argument("--repeat", type=int, default=3, help="repetitions of every run (default 3)")
+    parser.add_argument("--timeout", type=float, default=3600, help="timeout of one run in seconds")
+    parser.add_argument("--no-trace", action="store_true", help="skip the per-stage traced runs")
+    parser.add_argument("--mpirun", default="mpirun", help="mpirun command (default mpirun)")
+    parser.add_argument("--mpirun-args", default="--oversubscribe",
+                        help="extra mpirun arguments (default --oversubscribe)")
+    parser.add_argument("--mpicxx", default="mpic++", help="compiler (default mpic++)")
+    parser.add_argument("--work-dir", help="directory for the binaries and data (default a new temporary one)")
+    parser.add_argument("--output", default="bench-results.jsonl", help="result file (default bench-results.jsonl)")
+    parser.add_argument("--compare", nargs=2, metavar=("OLD", "NEW"),
+                        help="compare two result files instead of running the benchmark")
+    return parser.parse_args()
+
+
+def compile_binaries(args, work_dir):
+    """Build pms and (unless --no-trace) pms with -DPMS_TRACE."""
+    binaries = {"plain": os.path.join(work_dir, "pms")}
+    if not args.no_trace:
+        binaries["trace"] = os.path.join(work_dir, "pms-trace")
+    for name, path in binaries.items():
+        command = [args.mpicxx, "-std=c++17", "-O2", SOURCE, "-o", path]
+        if name == "trace":
+            command.insert(1, "-DPMS_TRACE")
+        subprocess.run(command, check=True)
+    return binaries
+
+
+def generate_input(path, key_type, distribution, count):
+    """Write `count` elements of the given type and distribution to `path` (raw, little endian)."""
+    size, code = TYPES[key_type]
+    # Random bytes, the top exponent bit of doubles is cleared so there are no NaNs or infinities
+    finite = bytes(value & 0xBF for value in range(256))
+    small = bytes(value % DUPLICATE_KEYS for value in range(256))
+
+    with open(path, "wb") as output:
+        for start in range(0, count, GENERATE_BLOCK):
+            block = min(GENERATE_BLOCK, count - start)
+            if distribution == "duplicates":
+                # Only the lowest byte (of the key) is set
+                data = bytearray(block * size)
+                data[0::size] = os.urandom(block).translate(small)
+            else:
+                data = bytearray(os.urandom(block * size))
+                if key_type == "f64":
+                    data[7::8] = bytes(data[7::8]).translate(finite)
+            output.write(data)
+
+    if distribution in ("sorted", "reverse"):
+        # The baseline sorts the random data, the reversed order is made from the sorted one
+        return True
+    return False
+
+
+def reverse_file(path, key_type):
+    """Reverse the order of the elements of a file in place."""
+    size, code = TYPES[key_type]
+    elements = array(code)
+    with open(path, "rb") as source:
+        elements.frombytes(source.read())
+    elements.reverse()
+    if key_type == "kv":
+        # Reversing the 64-bit words also swapped the key and the payload of every record
+        elements[0::2], elements[1::2] = elements[1::2], elements[0::2]
+    with open(path, "wb") as output:
+        elements.tofile(output)
+
+
+def processes_for(count, presort):
+    """Number of pipeline stages needed for `count` elements with runs of 2^presort."""
+    return max(2, math.ceil(math.log2(max(count, 1))) + 1 - presort)
+
+
+def run_pms(args, binary, processes, options, timeout):
+    """Run one sort and return its wall time in seconds (None on failure)."""
+    command = [binary] + options
+    if processes > 0:
+        command = [args.mpirun] + args.mpirun_args.split() + ["-np", str(processes)] + command
+    start = time.perf_counter()
+    try:
+        result = subprocess.run(command, stdout=subprocess.DEVNULL, stderr=subprocess.PIPE,
+                                text=True, timeout=timeout)
+    except subprocess.TimeoutExpired:
+        print("  timeout: " + " ".join(command), file=sys.stderr)
+        return None
+    elapsed = time.perf_counter() - start
+    if result.returncode != 0:
+        print("  failed: " + " ".join(command) + "\n" + result.stderr, file=sys.stderr)
+        return None
+    return elapsed
+
+
+def sweep(args, count):
+    """All configurations of the sweep for `count` elements: (engine, processes, options)."""
+    configurations = []
+    for engine in parse_list(args.engines):
+        if engine == "sample":
+            configurations.append(({"engine": "sample", "processes": args.sample_procs},
+                                   ["-e", "sample"]))
+            continue
+        for presort in parse_list(args.presort, int):
+            stages = processes_for(count, presort)
+            for chunk in parse_list(args.chunks, int):
+                for window in parse_list(args.windows, int) if chunk > 0 else [0]:
+                    options = ["-r", str(presort)]
+                    if chunk > 0:
+                        options += ["-b", str(chunk), "-w", str(window)]
+                    config = {"engine": engine, "processes": stages, "chunk": chunk,
+                              "window": window, "presort": presort}
+                    if engine == "threads":
+                        config["processes"] = 1
+                        config["stages"] = stages
+                        options += ["-j", str(stages)]
+                    configurations.append((config, options))
+    return configurations
+
+
+def stage_times(trace_path):
+    """Per-stage summary of a trace written by the -DPMS_TRACE build."""
+    with open(trace_path) as source:
+        stages = json.load(source)["stages"]
+    return [{key: stage[key] for key in ("stage", "total", "recvWait", "sendWait", "work",
+                                         "maxTop", "maxBottom", "messagesSent")}
+            for stage in stages]
+
+
+def time_runs(args, binary, processes, options):
+    times = []
+    for _ in range(args.repeat):
+        elapsed = run_pms(args, binary, processes, options, args.timeout)
+        if elapsed is None:
+            return None
+        times.append(elapsed)
+    return times
+
+
+def run_benchmark(args):
+    work_dir = args.work_dir or tempfile.mkdtemp(prefix="pms-bench-")
+    os.makedirs(work_dir, exist_ok=True)
+    binaries = compile_binaries(args, work_dir)
+    input_path = os.path.join(work_dir, "input.bin")
+    expected_path = os.path.join(work_dir, "expected.bin")
+    output_path = os.path.join(work_dir, "output.bin")
+    trace_path = os.path.join(work_dir, "trace.json")
+
+    common = {
+        "date": datetime.datetime.now().isoformat(timespec="seconds"),
+        "host": platform.node(),
+        "cpus": os.cpu_count(),
+        "commit": subprocess.run(["git", "rev-parse", "--short", "HEAD"], capture_output=True, text=True,
+                                 cwd=os.path.dirname(SOURCE)).stdout.strip(),
+    }
+
+    failures = 0
+    with open(args.output, "a") as results:
+        for key_type in parse_list(args.types):
+            for distribution in parse_list(args.distributions):
+                for exponent in range(args.min_exp, args.max_exp + 1, args.exp_step):
+                    count = 1 << exponent
+                    print(f"{key_type} {distribution} N=2^{exponent}", flush=True)
+
+                    # Input and the baseline (which is also the expected output)
+                    io = ["-t", key_type, "-q", "-f", "bin"]
+                    needs_sorting = generate_input(input_path, key_type, distribution, count)
+                    if needs_sorting:
+                        run_pms(args, binaries["plain"], 1, ["-e", "serial", "-i", input_path, "-o", expected_path] + io,
+                                args.timeout)
+                        shutil.move(expected_path, input_path)
+                        if distribution == "reverse":
+                            reverse_file(input_path, key_type)
+                    baseline = time_runs(args, binaries["plain"], 1,
+                                         ["-e", "serial", "-i", input_path, "-o", expected_path] + io)
+                    if baseline is None:
+                        failures += 1
+                        continue
+
+                    for config, options in [({"engine": "serial", "processes": 1}, ["-e", "serial"])] + sweep(args, count):
+                        processes = config["processes"]
+                        options = options + ["-i", input_path, "-o", output_path] + io
+                        times = baseline if config["engine"] == "serial" else \
+                            time_runs(args, binaries["plain"], processes, options)
+                        record = dict(common)
+                        record["config"] = dict(config, type=key_type, distribution=distribution, n=count)
+                        if times is None:
+                            record["status"] = "failed"
+                            failures += 1
+                        else:
+                            correct = config["engine"] == "serial" or filecmp.cmp(output_path, expected_path, shallow=False)
+                            median = statistics.median(times)
+                            record.update({
+                                "status": "ok" if correct else "wrong output",
+                                "wall_median": median,
+                                "wall_min": min(times),
+                                "elements_per_second": count / median,
+                                "speedup_vs_serial": statistics.median(baseline) / median,
+                            })
+                            failures += not correct
+                            if "trace" in binaries and config["engine"] in ("pipeline", "threads"):
+                                if run_pms(args, binaries["trace"], processes,
+                                           options + ["-x", trace_path], args.timeout) is not None:
+                                    record["stages"] = stage_times(trace_path)
+                        results.write(json.dumps(record) + "\n")
+                        results.flush()
+                        print("  {:<8} np={:<3} chunk={:<6} {:>10} {:>14}".format(
+                            config["engine"], processes, config.get("chunk", "-"), record["status"],
+                            "{:.4f} s".format(record["wall_median"]) if "wall_median" in record else "-"), flush=True)
+
+                    for path in (input_path, expected_path, output_path):
+                        if os.path.exists(path):
+                            os.remove(path)
+
+    if not args.work_dir:
+        shutil.rmtree(work_dir)
+    return failures
+
+
+def config_key(record):
+    return json.dumps(record["config"], sort_keys=True)
+
+
+def compare(old_path, new_path):
+    """Print the change of the median wall time of every configuration present in both files."""
+    def load(path):
+        records = {}
+        with open(path) as source:
+            for line in source:
+                record = json.loads(line)
+                if record.get("status") == "ok":
+                    # The last run of a configuration wins
+                    records[config_key(record)] = record
+        return records
+
+    old, new = load(old_path), load(new_path)
+    print("{:<6} {:<10} {:>6} {:<8} {:>4} {:>6} {:>12} {:>12} {:>8}".format(
+        "type", "dist", "log2N", "engine", "np", "chunk", "old [s]", "new [s]", "speedup"))
+    for key in sorted(old.keys() & new.keys(), key=lambda k: (old[k]["config"]["type"], old[k]["config"]["distribution"],
+                                                              old[k]["config"]["n"], k)):
+        config = old[key]["config"]
+        before, after = old[key]["wall_median"], new[key]["wall_median"]
+        print("{:<6} {:<10} {:>6} {:<8} {:>4} {:>6} {:>12.4f} {:>12.4f} {:>7.2f}x".format(
+            config["type"], config["distribution"], int(math.log2(config["n"])), config["engine"],
+            config["processes"], config.get("chunk", "-"), before, after, before / after))
+
+
+if __name__ == "__main__":
+    arguments = parse_arguments()
+    if arguments.compare:
+        compare(*arguments.compare)
+        sys.exit(0)
+    sys.exit(1 if run_benchmark(arguments) else 0)
@@ -6,20 +6,84 @@
  * Date Created: 2024-03-29
  * Description: Implementation file for the Pipeline Merge Sort (PMS) system.
  *              This program implements a pipeline merge sort algorithm
- *              capable of sorting 2^i numbers efficiently.
+ *              capable of sorting any count of numbers efficiently.
  ***************************************************************/
 
 /***************************************************************
  * Compile with: mpic++ -std=c++17 pms.cpp -o pms
+ *               mpic++ -std=c++17 -DPMS_TRACE pms.cpp -o pms   (with instrumentation)
  * 
- * Run with:        mpirun -np {number of processes} ./pms
+ * Run with:        mpirun -np {number of processes} ./pms [-b chunk] [-w window] [-t type]
+ *                      [-i input] [-o output] [-f text|bin] [-q] [-r k] [-m MiB] [-d dir]
+ *                      [-e pipeline|sample|serial] [-j stages] [-p] [-s jobs]
  * 
  * Example:         mpirun -np 4 ./pms
+ *                  mpirun -np 4 ./pms -b 4096 -t i64
+ *                  mpirun -np 21 ./pms -b 65536 -t u32 -q -i data.bin -o sorted.bin -f bin
+ *                  mpirun -np 11 ./pms -b 65536 -t u32 -q -i data.bin -o sorted.bin -f bin -r 10
+ *                  mpirun -np 25 ./pms -b 65536 -t u64 -q -i big.bin -o sorted.bin -f bin -m 512 -d /scratch
+ *                  mpirun -np 64 ./pms -e sample -t u64 -q -i big.bin -o sorted.bin -f bin
+ *                  ./pms -j 21 -p -t u32 -q -i data.bin -o sorted.bin -f bin
+ *                  mpirun -np 25 ./pms -b 65536 -q -f bin -s jobs.txt
  * 
- * Capabilities:    This program can sort 2^i numbers ascending, where i is the 
- *                  number of processes.
+ * Options:         -b chunk    Block transport: stages exchange blocks of up to
+ *                              `chunk` elements instead of one message per number.
+ *                              The end of the stream is flagged in the block header.
+ *                              Without -b every number is sent as its own message.
+ *                  -w window   Number of blocks in flight between two processes (default 2).
+ *                              Blocks are sent and received without blocking, the receiver
+ *                              returns a credit for every used block, so each link holds
+ *                              at most `window` blocks on each side.
+ *                  -t type     Type of the elements in the input file (raw binary,
+ *                              native byte order): u8 (default), i32, u32, i64, u64,
+ *                              f64, or kv (records of a 64-bit signed key and a
+ *                              64-bit payload, sorted by the key).
+ *                  -i input    Input file (default "numbers", "-" for stdin). Regular
+ *                              files are memory mapped, others are read in large blocks.
+ *                  -o output   Output file written by the last process (default stdout).
+ *                  -f format   Output format: text (default, one number per line)
+ *                              or bin (raw elements, same layout as the input).
+ *                  -q          Do not print the unsorted numbers.
+ *                  -r k        The first process sorts blocks of 2^k numbers (radix sort)
+ *                              before sending them, so the pipeline starts with runs of
+ *                              2^k numbers and needs only log2(N / 2^k) + 1 processes.
+ *                  -m MiB      Out-of-core mode: the queues of every stage keep at most
+ *                              MiB megabytes in memory, the rest is spilled to temporary
+ *                              files and read back sequentially.
+ *                  -d dir      Directory for the temporary files (default $TMPDIR or /tmp).
+ *                  -e engine   pipeline (default) is the pipeline merge sort described below.
+ *                              sample is a parallel sample sort: every process reads and
+ *                              sorts its own slice of the input, the data is redistributed
+ *                              by splitters with MPI_Alltoallv and merged locally. It works
+ *                              with any number of processes and gives the same output,
+ *                              but every process holds its slice in memory (-r, -m unused).
+ *                              serial sorts the whole input with std::stable_sort in a
+ *                              single process, it is the baseline for benchmark.py.
+ *                  -j stages   Thread backend: the pipeline runs with `stages` stages as
+ *                              threads of a single process (no mpirun needed), connected
+ *                              by lock-free single-producer/single-consumer ring buffers.
+ *                  -p          Pin the stage threads to cores (stage i to core i).
+ *                  -s jobs     Service mode: the pipeline stays up and sorts one job after
+ *                              another. Every line of the file `jobs` ("-" for stdin) is
+ *                              "input output [type]" (type defaults to -t, empty lines and
+ *                              lines starting with # are skipped), the other options apply
+ *                              to all jobs. The job descriptor travels through the pipeline
+ *                              in front of the job's data, so a stage starts the next job
+ *                              as soon as it has passed on the previous one while the later
+ *                              stages are still draining it.
+ *                  -x trace    Only when compiled with -DPMS_TRACE: every stage counts
+ *                              the elements and messages it received and sent, the time
+ *                              blocked in receiving and sending, the largest queue sizes
+ *                              and the batches. At the end a Chrome trace (JSON, default
+ *                              "pms-trace.json") is written and a summary table is printed
+ *                              to stderr. Without -DPMS_TRACE nothing of it is compiled.
+ * 
+ * Capabilities:    This program can sort up to 2^(i-1) numbers ascending, where i
+ *                  is the number of processes (2^(i-1+k) numbers with -r k).
+ *                  The count of numbers does not have to be a power of two.
  *                  The program reads the numbers from a file called "numbers"
- *                  and outputs the sorted numbers to the console.
+ *                  and outputs the sorted numbers to the console (both can be
+ *                  changed with -i and -o).
  * 
  * Tested on:       This program was tested on the Merlin cluster.
  *                  Program was tested on 1, 2, 4, 8, 16, 32, 64, 128, 256, 512 processes.
@@ -27,156 +91,2247 @@
  ***************************************************************/
 
 #include <iostream>
-#include <fstream>
 #include <mpi.h>
 #include <deque>
+#include <memory>
 #include <vector>
 #include <algorithm>
-#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <charconv>
+#include <type_traits>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fstream>
+#include <sstream>
+#include <atomic>
+#include <thread>
+#include <pthread.h>
 
 // Constants for message tags
 constexpr int MSG_TAG = 0;
 constexpr int MSG_FINAL = 1;
+constexpr int MSG_BLOCK = 2;
+constexpr int MSG_CREDIT = 3;
+constexpr int MSG_JOB = 4;
+
+// Capacity of the ring buffers of the thread backend when -b is not given (elements)
+constexpr size_t THREAD_RING_CAPACITY = 1 << 16;
+
+// Size of a cache line, the indices of the ring buffers are kept on separate lines
+constexpr size_t CACHE_LINE_SIZE = 64;
+
+// Number of unsuccessful polls of a ring buffer before the thread yields
+constexpr int SPIN_COUNT = 64;
+
+// Default number of block buffers on each side of a link
+constexpr int DEFAULT_WINDOW = 2;
+
+// Flags stored in the block header
+constexpr uint32_t BLOCK_FLAG_FINAL = 1;
 
-constexpr int MIN_ITEMS_IN_BOTTOM_QUEUE = 1;
+// Size of the buffers used for reading and writing the files
+constexpr size_t IO_BUFFER_SIZE = 1 << 20;
+
+// Samples taken from every process by the sample sort (multiplied by the number of processes)
+constexpr int SAMPLES_PER_PROCESS = 4;
+
+// Chunk size used to collect the output of the sample sort when -b is not given
+constexpr int SAMPLE_OUTPUT_CHUNK = 65536;
+
+// Largest part of a file read or written by one MPI-IO call
+constexpr size_t MPI_IO_CHUNK = 1 << 30;
+
+// Number of bytes in one megabyte of the memory limit
+constexpr size_t MEGABYTE = 1 << 20;
+
+// Largest allowed exponent of the presorted run length, blocks shorter than the threshold use a comparison sort
+constexpr int MAX_PRESORT_EXPONENT = 32;
+constexpr size_t RADIX_SORT_THRESHOLD = 64;
 
 // Enum to distinguish between top and bottom queues
 enum QueuePosition
 {
-    Q_TOP,
-    Q_BOTTOM
-};
+    Q_TOP,
+    Q_BOTTOM
+};
+
+// Element types the pipeline can sort
+enum KeyType
+{
+    KEY_U8,
+    KEY_I32,
+    KEY_U32,
+    KEY_I64,
+    KEY_U64,
+    KEY_F64,
+    KEY_KV
+};
+
+// Sorting engines
+enum SortEngine
+{
+    ENGINE_PIPELINE,
+    ENGINE_SAMPLE,
+    ENGINE_SERIAL
+};
+
+// Formats of the output file
+enum OutputFormat
+{
+    OUT_TEXT,
+    OUT_BINARY
+};
+
+// Program options (same on every rank, parsed from the command line)
+struct PmsOptions
+{
+    // Number of elements per message, 0 = one message per element
+    int chunkSize = 0;
+    // Number of blocks in flight between two processes
+    int window = DEFAULT_WINDOW;
+    // Type of the sorted elements
+    KeyType keyType = KEY_U8;
+    // Engine used for sorting
+    SortEngine engine = ENGINE_PIPELINE;
+    // Input file ("-" = stdin) and output file ("-" = stdout)
+    std::string inputPath = "numbers";
+    std::string outputPath = "-";
+    OutputFormat outputFormat = OUT_TEXT;
+    // Print the unsorted numbers on the first process
+    bool echo = true;
+    // The first process sends sorted runs of 2^presortExponent numbers
+    int presortExponent = 0;
+    // Number of stage threads of the thread backend (0 = MPI backend) and pinning of the threads
+    int threads = 0;
+    bool pinThreads = false;
+    // Memory limit of the queues of one stage in MiB (0 = unlimited) and directory for spilled data
+    size_t memoryLimit = 0;
+    std::string tempDir = getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp";
+    // Trace file written by the instrumented build
+    std::string tracePath = "pms-trace.json";
+    // Queue of job descriptors of the service mode (empty = sort a single input)
+    std::string jobQueue;
+};
+
+// Longest text form of any element (a record is two 64-bit numbers and a colon)
+constexpr size_t FORMAT_BUFFER_SIZE = 64;
+
+// Fixed-size record sorted by its key, the payload travels with it
+struct KeyValueRecord
+{
+    int64_t key;
+    uint64_t payload;
+
+    bool operator==(const KeyValueRecord &other) const
+    {
+        return key == other.key && payload == other.payload;
+    }
+};
+
+/**
+ * struct PmsTraits<T>
+ * 
+ * @brief Maps an element type to its MPI datatype, ordering and text output.
+ * 
+ * format() writes the text form of a value to [first, last) and returns the end of the text,
+ * last - first has to be at least FORMAT_BUFFER_SIZE.
+ * radixKey() maps a value to an unsigned number with the same order as less(), only the lowest
+ * RADIX_BYTES bytes of it are used.
+ * 
+ * The primary template covers arithmetic types, the records have their own specialization.
+ * Everything is resolved at compile time, so no per-element dispatch happens in the stages.
+ */
+template <typename T>
+struct PmsTraits
+{
+    static MPI_Datatype mpiType();
+
+    static constexpr int RADIX_BYTES = sizeof(T);
+
+    static bool less(const T &a, const T &b)
+    {
+        return a < b;
+    }
+
+    static uint64_t radixKey(const T &value)
+    {
+        if constexpr (std::is_floating_point_v<T>)
+        {
+            // Negative numbers have all bits flipped, positive ones only the sign bit
+            uint64_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            return (bits >> 63) ? ~bits : bits | (uint64_t(1) << 63);
+        }
+        else if constexpr (std::is_signed_v<T>)
+        {
+            return uint64_t(std::make_unsigned_t<T>(value)) ^ (uint64_t(1) << (8 * sizeof(T) - 1));
+        }
+        else
+        {
+            return value;
+        }
+    }
+
+    static char *format(char *first, char *last, const T &value)
+    {
+        return std::to_chars(first, last, value).ptr;
+    }
+
+    static void print(std::ostream &os, const T &value)
+    {
+        char text[FORMAT_BUFFER_SIZE];
+        os.write(text, format(text, text + sizeof(text), value) - text);
+    }
+};
+
+template <> MPI_Datatype PmsTraits<uint8_t>::mpiType() { return MPI_UNSIGNED_CHAR; }
+template <> MPI_Datatype PmsTraits<int32_t>::mpiType() { return MPI_INT32_T; }
+template <> MPI_Datatype PmsTraits<uint32_t>::mpiType() { return MPI_UINT32_T; }
+template <> MPI_Datatype PmsTraits<int64_t>::mpiType() { return MPI_INT64_T; }
+template <> MPI_Datatype PmsTraits<uint64_t>::mpiType() { return MPI_UINT64_T; }
+template <> MPI_Datatype PmsTraits<double>::mpiType() { return MPI_DOUBLE; }
+
+
+template <>
+struct PmsTraits<KeyValueRecord>
+{
+    static MPI_Datatype mpiType()
+    {
+        // The datatype is created on first use and lives until MPI_Finalize
+        static MPI_Datatype type = MPI_DATATYPE_NULL;
+        if (type == MPI_DATATYPE_NULL)
+        {
+            int lengths[] = {1, 1};
+            MPI_Aint displacements[] = {offsetof(KeyValueRecord, key), offsetof(KeyValueRecord, payload)};
+            MPI_Datatype types[] = {MPI_INT64_T, MPI_UINT64_T};
+            MPI_Type_create_struct(2, lengths, displacements, types, &type);
+            MPI_Type_commit(&type);
+        }
+        return type;
+    }
+
+    static constexpr int RADIX_BYTES = sizeof(int64_t);
+
+    static bool less(const KeyValueRecord &a, const KeyValueRecord &b)
+    {
+        return a.key < b.key;
+    }
+
+    static uint64_t radixKey(const KeyValueRecord &value)
+    {
+        return uint64_t(value.key) ^ (uint64_t(1) << 63);
+    }
+
+    static char *format(char *first, char *last, const KeyValueRecord &value)
+    {
+        auto key = std::to_chars(first, last, value.key);
+        if (key.ec != std::errc() || key.ptr == last)
+        {
+            return key.ptr;
+        }
+        *key.ptr = ':';
+        return std::to_chars(key.ptr + 1, last, value.payload).ptr;
+    }
+
+    static void print(std::ostream &os, const KeyValueRecord &value)
+    {
+        char text[FORMAT_BUFFER_SIZE];
+        os.write(text, format(text, text + sizeof(text), value) - text);
+    }
+};
+
+// Header preceding the elements of every block message
+struct BlockHeader
+{
+    uint32_t count;
+    uint32_t flags;
+};
+
+/**
+ * class StreamSender<T>
+ * 
+ * @brief Sends a stream of numbers to the next process in the pipeline.
+ * 
+ * In element mode every number is one MSG_TAG message and the end of the stream
+ * is an extra MSG_FINAL message. In block mode the numbers are buffered and sent
+ * as MSG_BLOCK messages of up to `chunkSize` numbers, the last block carries
+ * BLOCK_FLAG_FINAL in its header.
+ * 
+ * Blocks are sent with MPI_Isend from `window` buffers, so filling the next block overlaps
+ * with sending the previous ones. Every block needs a credit, the sender starts with `window`
+ * credits and the receiver returns one (MSG_CREDIT) for every block it has used. At most
+ * `window` blocks are therefore on the way or waiting at the receiver, and a slow receiver
+ * stops the sender (and everything before it) instead of letting its queues grow.
+ */
+template <typename T>
+class StreamSender
+{
+public:
+    StreamSender(int dest, int chunkSize, int window);
+
+    void send(const T &num);
+    void close();
+
+private:
+    int dest, chunkSize, window;
+    std::vector<std::vector<uint8_t>> buffers;
+    std::vector<MPI_Request> requests;
+    int current = 0, credits;
+    uint32_t count = 0;
+
+    void flush(uint32_t flags);
+};
+
+/**
+ * class StreamReceiver<T>
+ * 
+ * @brief Receives a stream of numbers from the previous process in the pipeline.
+ * 
+ * Counterpart of StreamSender, both sides have to use the same chunk size and window.
+ * In block mode a receive is posted for each of the `window` buffers in advance, the buffers
+ * are used in the order of posting and posted again once all their numbers were taken.
+ */
+template <typename T>
+class StreamReceiver
+{
+public:
+    StreamReceiver(int source, int chunkSize, int window);
+
+    bool receive(T &num);
+
+private:
+    int source, chunkSize, window;
+    std::vector<std::vector<uint8_t>> buffers;
+    std::vector<MPI_Request> requests;
+    int current = 0;
+    uint32_t count = 0, position = 0;
+    // A block is being read from the current buffer, the final block was received
+    bool active = false, finished = false;
+
+    void post(int index);
+    void release();
+};
+
+/**
+ * class InputReader<T>
+ * 
+ * @brief Reads the elements of the input file one by one.
+ * 
+ * Regular files are memory mapped and read sequentially, anything else (a pipe, stdin)
+ * is read in blocks of IO_BUFFER_SIZE bytes. A trailing incomplete element is ignored.
+ */
+template <typename T>
+class InputReader
+{
+public:
+    explicit InputReader(const std::string &path);
+    ~InputReader();
+
+    bool read(T &num);
+
+private:
+    int fd = -1;
+    // Mapped file (or nullptr when reading through the buffer)
+    const uint8_t *mapped = nullptr;
+    size_t size = 0, position = 0;
+    std::vector<uint8_t> buffer;
+
+    bool refill();
+};
+
+/**
+ * class OutputWriter<T>
+ * 
+ * @brief Writes the sorted elements to the output file through a large buffer.
+ */
+template <typename T>
+class OutputWriter
+{
+public:
+    OutputWriter(const std::string &path, OutputFormat format);
+    ~OutputWriter();
+
+    void write(const T &num);
+    void close();
+    void holdUntil(const std::atomic<bool> *released);
+
+private:
+    FILE *file = nullptr;
+    OutputFormat format;
+    std::vector<char> buffer;
+    size_t count = 0;
+    // While set and false, nothing is written and the buffer grows instead
+    const std::atomic<bool> *released = nullptr;
+
+    void flush();
+    bool held() const { return released && !released->load(std::memory_order_acquire); }
+};
+
+/**
+ * class SpscRing<T>
+ * 
+ * @brief Lock-free single-producer/single-consumer ring buffer linking two stage threads.
+ * 
+ * The producer only writes `tail`, the consumer only writes `head`, both live on their own
+ * cache line. Each side keeps a copy of the other side's index and reads the shared one only
+ * when the copy says the ring is full (or empty). A waiting side spins for a while and then yields.
+ */
+template <typename T>
+class SpscRing
+{
+public:
+    explicit SpscRing(size_t capacity);
+
+    void push(const T &num);
+    void close();
+    bool pop(T &num);
+
+private:
+    std::vector<T> slots;
+    size_t mask;
+
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> head{0};
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> tail{0};
+    alignas(CACHE_LINE_SIZE) std::atomic<bool> closed{false};
+    // Producer's copy of head and consumer's copy of tail
+    alignas(CACHE_LINE_SIZE) size_t cachedHead = 0;
+    alignas(CACHE_LINE_SIZE) size_t cachedTail = 0;
+};
+
+/**
+ * class RingSender<T> / RingReceiver<T>
+ * 
+ * @brief StreamSender/StreamReceiver counterparts of the thread backend.
+ */
+template <typename T>
+class RingSender
+{
+public:
+    explicit RingSender(SpscRing<T> *ring) : ring(ring) {}
+
+    void send(const T &num) { ring->push(num); }
+    void close() { ring->close(); }
+
+private:
+    SpscRing<T> *ring;
+};
+
+template <typename T>
+class RingReceiver
+{
+public:
+    explicit RingReceiver(SpscRing<T> *ring) : ring(ring) {}
+
+    bool receive(T &num) { return ring->pop(num); }
+
+private:
+    SpscRing<T> *ring;
+};
+
+/**
+ * class SpillQueue<T>
+ * 
+ * @brief FIFO queue of a stage that keeps a bounded number of elements in memory.
+ * 
+ * The oldest elements are kept in memory (`head`). Once the head is full, new elements are
+ * collected in `tail` and written to a temporary file block by block. Reading goes from the
+ * head, then from the file and then from the tail, so the order is preserved.
+ * The file is created only when needed, it is unlinked right away so it disappears with the process.
+ * Without a limit nothing is ever spilled.
+ */
+template <typename T>
+class SpillQueue
+{
+public:
+    SpillQueue(size_t memoryLimit, const std::string &tempDir);
+    ~SpillQueue();
+
+    void push_back(const T &num);
+    void pop_front();
+    const T &front() const { return head.front(); }
+    bool empty() const { return head.empty(); }
+    size_t size() const { return length; }
+
+private:
+    std::deque<T> head;
+    size_t length = 0;
+    std::vector<T> tail;
+    std::string tempDir;
+    // Capacity of the head and the size of one spilled block (elements)
+    size_t headCapacity, blockSize;
+    // Temporary file and the spilled elements in it
+    int fd = -1;
+    uint64_t readOffset = 0, writeOffset = 0;
+
+    void spill();
+    void load();
+};
+
+#ifdef PMS_TRACE
+// Kinds of the recorded intervals
+enum TraceKind
+{
+    TRACE_RECV,
+    TRACE_SEND
+};
+
+// Shortest recorded interval (s) and the largest number of intervals kept by one stage
+constexpr double TRACE_MIN_EVENT = 10e-6;
+constexpr size_t TRACE_MAX_EVENTS = 100000;
+
+// One interval a stage spent blocked, times are relative to the start of the run (s)
+struct TraceEvent
+{
+    double start, duration;
+    int kind;
+};
+
+// Counters of one stage, times in seconds
+struct StageSummary
+{
+    int stage;
+    uint64_t elementsReceived, elementsSent, messagesReceived, messagesSent;
+    uint64_t maxTop, maxBottom, batches;
+    double total, recvWait, sendWait;
+};
+
+/**
+ * class StageTrace
+ * 
+ * @brief Instrumentation of one pipeline stage (compiled only with -DPMS_TRACE).
+ * 
+ * Every stage (process or thread) owns one StageTrace, `stageTrace` points to it from the
+ * stage's thread, so the streams can count their messages without knowing the stage.
+ */
+class StageTrace
+{
+public:
+    StageSummary summary{};
+    std::vector<TraceEvent> events;
+
+    void begin(int stage, double origin);
+    void end();
+    void wait(int kind, double start, double stop);
+
+private:
+    double origin = 0;
+};
+
+thread_local StageTrace *stageTrace = nullptr;
+
+/**
+ * class TraceTimer
+ * 
+ * @brief Measures the time of its scope as a blocked interval of the current stage.
+ */
+class TraceTimer
+{
+public:
+    explicit TraceTimer(int kind) : kind(kind), start(MPI_Wtime()) {}
+    ~TraceTimer()
+    {
+        if (stageTrace)
+        {
+            stageTrace->wait(kind, start, MPI_Wtime());
+        }
+    }
+
+private:
+    int kind;
+    double start;
+};
+
+#define TRACE_WAIT(kind) TraceTimer traceTimer(kind)
+#define TRACE_COUNT(counter, n) (stageTrace ? void(stageTrace->summary.counter += (n)) : void())
+#define TRACE_MAX(counter, value) (stageTrace ? void(stageTrace->summary.counter = std::max<uint64_t>(stageTrace->summary.counter, (value))) : void())
+// Option of the trace file (getopt string and usage)
+#define TRACE_OPTION        "x:"
+#define TRACE_USAGE         " [-x trace]"
+
+void gatherTrace(int procID, int noProc, StageTrace &trace, const std::string &path);
+#else
+#define TRACE_WAIT(kind)
+#define TRACE_COUNT(counter, n)
+#define TRACE_MAX(counter, value)
+#define TRACE_OPTION        ""
+#define TRACE_USAGE         ""
+#endif
+
+// Function prototypes
+PmsOptions parseArguments(int argc, char *argv[]);
+bool parseKeyType(const std::string &name, KeyType &type);
+void sortWithType(int procID, int noProc, const PmsOptions &options);
+void runService(int procID, int noProc, const PmsOptions &options);
+std::string nextJob(std::istream &queue, const PmsOptions &options);
+template <typename T>
+void sortRun(std::vector<T> &run, std::vector<T> &scratch);
+template <typename T>
+void runSort(int procID, int noProc, const PmsOptions &options);
+template <typename T>
+void sampleSort(int procID, int noProc, const PmsOptions &options);
+template <typename T>
+void writeSampleSortOutput(int procID, int noProc, const PmsOptions &options, const std::vector<T> &sorted);
+template <typename T>
+void serialSort(const PmsOptions &options);
+template <typename T>
+void runThreads(const PmsOptions &options);
+template <typename T, typename Sender>
+void processFirst(const PmsOptions &options, Sender &sender);
+template <typename T, typename Receiver, typename Sender>
+void processOthers(int procID, int noProc, const PmsOptions &options, Receiver &receiver, Sender &sender,
+                   OutputWriter<T> *writer);
+
+
+int main(int argc, char *argv[])
+{
+    MPI_Init(&argc, &argv);
+
+    int procID, noProc;
+    MPI_Comm_rank(MPI_COMM_WORLD, &procID);
+    MPI_Comm_size(MPI_COMM_WORLD, &noProc);
+
+    PmsOptions options = parseArguments(argc, argv);
+
+    if (options.threads > 0 && (noProc > 1 || options.engine != ENGINE_PIPELINE))
+    {
+        std::cerr << "The thread backend (-j) runs the pipeline in a single process." << std::endl;
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    if (!options.jobQueue.empty() && (options.engine != ENGINE_PIPELINE || options.threads > 0))
+    {
+        std::cerr << "The service mode (-s) runs the MPI pipeline." << std::endl;
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    if (noProc > 1 && options.engine == ENGINE_SERIAL)
+    {
+        std::cerr << "The serial engine runs in a single process." << std::endl;
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    if (noProc < 2 && options.engine == ENGINE_PIPELINE && options.threads == 0)
+    {
+        std::cerr << "This program requires at least 2 MPI processes." << std::endl;
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    if (!options.jobQueue.empty())
+    {
+        runService(procID, noProc, options);
+    }
+    else
+    {
+        sortWithType(procID, noProc, options);
+    }
+
+    MPI_Finalize();
+    return 0;
+}
+
+
+/**
+ * PmsOptions parseArguments(int argc, char *argv[])
+ * 
+ * @brief Parse the command line options.
+ * 
+ * @param argc Number of command-line arguments.
+ * @param argv Array of command-line arguments.
+ * 
+ * @return Parsed options.
+ * 
+ * Every process parses the same arguments, so all of them agree on the transport.
+ * 
+*/
+PmsOptions parseArguments(int argc, char *argv[])
+{
+    PmsOptions options;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "b:w:t:i:o:f:qr:m:d:e:j:ps:" TRACE_OPTION)) != -1)
+    {
+        switch (opt)
+        {
+        case 'b':
+            options.chunkSize = atoi(optarg);
+            if (options.chunkSize < 1)
+            {
+                std::cerr << "Chunk size must be a positive number." << std::endl;
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+            break;
+        case 'w':
+            options.window = atoi(optarg);
+            if (options.window < 1)
+            {
+                std::cerr << "Window must be a positive number." << std::endl;
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+            break;
+        case 't':
+            if (!parseKeyType(optarg, options.keyType))
+            {
+                std::cerr << "Unknown element type: " << optarg << std::endl;
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+            break;
+        case 'i':
+            options.inputPath = optarg;
+            break;
+        case 'o':
+            options.outputPath = optarg;
+            break;
+        case 'f':
+            if (std::string(optarg) == "text")
+                options.outputFormat = OUT_TEXT;
+            else if (std::string(optarg) == "bin")
+                options.outputFormat = OUT_BINARY;
+            else
+            {
+                std::cerr << "Unknown output format: " << optarg << std::endl;
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+            break;
+        case 'q':
+            options.echo = false;
+            break;
+        case 'r':
+            options.presortExponent = atoi(optarg);
+            if (options.presortExponent < 0 || options.presortExponent > MAX_PRESORT_EXPONENT)
+            {
+                std::cerr << "Presort exponent must be between 0 and " << MAX_PRESORT_EXPONENT << "." << std::endl;
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+            break;
+        case 'm':
+            if (atoll(optarg) < 1)
+            {
+                std::cerr << "Memory limit must be a positive number of MiB." << std::endl;
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+            options.memoryLimit = atoll(optarg) * MEGABYTE;
+            break;
+        case 'd':
+            options.tempDir = optarg;
+            break;
+        case 'e':
+            if (std::string(optarg) == "pipeline")
+                options.engine = ENGINE_PIPELINE;
+            else if (std::string(optarg) == "sample")
+                options.engine = ENGINE_SAMPLE;
+            else if (std::string(optarg) == "serial")
+                options.engine = ENGINE_SERIAL;
+            else
+            {
+                std::cerr << "Unknown engine: " << optarg << std::endl;
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+            break;
+        case 'j':
+            options.threads = atoi(optarg);
+            if (options.threads < 2)
+            {
+                std::cerr << "The thread backend needs at least 2 stages." << std::endl;
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+            break;
+        case 'p':
+            options.pinThreads = true;
+            break;
+        case 's':
+            options.jobQueue = optarg;
+            break;
+#ifdef PMS_TRACE
+        case 'x':
+            options.tracePath = optarg;
+            break;
+#endif
+        default:
+            std::cerr << "Usage: " << argv[0] << " [-b chunk] [-w window] [-t u8|i32|u32|i64|u64|f64|kv]"
+                      << " [-i input] [-o output] [-f text|bin] [-q] [-r k] [-m MiB] [-d dir]"
+                      << " [-e pipeline|sample|serial] [-j stages] [-p] [-s jobs]" TRACE_USAGE << std::endl;
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+
+    return options;
+}
+
+
+/**
+ * bool parseKeyType(const std::string &name, KeyType &type)
+ * 
+ * @brief Convert the name of an element type (as in -t) to KeyType.
+ * 
+ * @param name Name of the type.
+ * @param type The parsed type.
+ * 
+ * @return false if the name is unknown (type is not changed), true otherwise.
+ * 
+*/
+bool parseKeyType(const std::string &name, KeyType &type)
+{
+    if (name == "u8")
+        type = KEY_U8;
+    else if (name == "i32")
+        type = KEY_I32;
+    else if (name == "u32")
+        type = KEY_U32;
+    else if (name == "i64")
+        type = KEY_I64;
+    else if (name == "u64")
+        type = KEY_U64;
+    else if (name == "f64")
+        type = KEY_F64;
+    else if (name == "kv")
+        type = KEY_KV;
+    else
+        return false;
+    return true;
+}
+
+
+/**
+ * void sortWithType(int procID, int noProc, const PmsOptions &options)
+ * 
+ * @brief Run runSort for the element type selected in the options.
+ * 
+ * @param procID The process ID.
+ * @param noProc The number of processes.
+ * @param options Program options.
+ * 
+ * @return void
+ * 
+*/
+void sortWithType(int procID, int noProc, const PmsOptions &options)
+{
+    switch (options.keyType)
+    {
+    case KEY_U8:
+        runSort<uint8_t>(procID, noProc, options);
+        break;
+    case KEY_I32:
+        runSort<int32_t>(procID, noProc, options);
+        break;
+    case KEY_U32:
+        runSort<uint32_t>(procID, noProc, options);
+        break;
+    case KEY_I64:
+        runSort<int64_t>(procID, noProc, options);
+        break;
+    case KEY_U64:
+        runSort<uint64_t>(procID, noProc, options);
+        break;
+    case KEY_F64:
+        runSort<double>(procID, noProc, options);
+        break;
+    case KEY_KV:
+        runSort<KeyValueRecord>(procID, noProc, options);
+        break;
+    }
+}
+
+
+/**
+ * void runService(int procID, int noProc, const PmsOptions &options)
+ * 
+ * @brief Sort the jobs of the job queue one after another without restarting the pipeline.
+ * 
+ * @param procID The process ID.
+ * @param noProc The number of processes.
+ * @param options Program options (jobQueue is read by the first process).
+ * 
+ * @return void
+ * 
+ * The first process reads the descriptors ("input\noutput\ntype") from the queue, every process
+ * receives the descriptor of the next job from the previous process (MSG_JOB), passes it on
+ * and runs its stage of the job. The streams of one job end with their final message, so the
+ * descriptor of the next job always arrives after all data of the previous one.
+ * An empty descriptor ends the service. With -DPMS_TRACE the stage is traced over all jobs and
+ * the trace is gathered once at the end, so the jobs are not synchronized by it.
+ * 
+*/
+void runService(int procID, int noProc, const PmsOptions &options)
+{
+    std::ifstream file;
+    std::istream *queue = &std::cin;
+    if (procID == 0 && options.jobQueue != "-")
+    {
+        file.open(options.jobQueue);
+        if (!file)
+        {
+            std::cerr << "Failed to open job queue." << std::endl;
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        queue = &file;
+    }
+
+#ifdef PMS_TRACE
+    StageTrace trace;
+    MPI_Barrier(MPI_COMM_WORLD);
+    trace.begin(procID, MPI_Wtime());
+#endif
+    std::string forwarded;
+    MPI_Request forward = MPI_REQUEST_NULL;
+    while (true)
+    {
+        std::string descriptor;
+        if (procID == 0)
+        {
+            descriptor = nextJob(*queue, options);
+        }
+        else
+        {
+            MPI_Status status;
+            int length;
+            MPI_Probe(procID - 1, MSG_JOB, MPI_COMM_WORLD, &status);
+            MPI_Get_count(&status, MPI_CHAR, &length);
+            descriptor.resize(length);
+            MPI_Recv(descriptor.data(), length, MPI_CHAR, procID - 1, MSG_JOB, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        }
+
+        // Pass the descriptor on before sorting, the next process starts the job as soon as it is free
+        if (procID < noProc - 1)
+        {
+            MPI_Wait(&forward, MPI_STATUS_IGNORE);
+            forwarded = descriptor;
+            MPI_Isend(forwarded.data(), forwarded.size(), MPI_CHAR, procID + 1, MSG_JOB, MPI_COMM_WORLD, &forward);
+        }
+        if (descriptor.empty())
+        {
+            break;
+        }
+
+        PmsOptions job = options;
+        std::istringstream fields(descriptor);
+        std::string type;
+        std::getline(fields, job.inputPath);
+        std::getline(fields, job.outputPath);
+        std::getline(fields, type);
+        parseKeyType(type, job.keyType);
+        sortWithType(procID, noProc, job);
+    }
+    MPI_Wait(&forward, MPI_STATUS_IGNORE);
+#ifdef PMS_TRACE
+    trace.end();
+    gatherTrace(procID, noProc, trace, options.tracePath);
+#endif
+}
+
+
+/**
+ * std::string nextJob(std::istream &queue, const PmsOptions &options)
+ * 
+ * @brief Read the next valid job from the job queue.
+ * 
+ * @param queue The job queue.
+ * @param options Program options (the default type).
+ * 
+ * @return Descriptor of the job ("input\noutput\ntype"), empty at the end of the queue.
+ * 
+ * Invalid jobs (unknown type, unreadable input) are reported and skipped, so one bad line
+ * does not stop the service.
+ * 
+*/
+std::string nextJob(std::istream &queue, const PmsOptions &options)
+{
+    const char *typeNames[] = {"u8", "i32", "u32", "i64", "u64", "f64", "kv"};
+    std::string line;
+    while (std::getline(queue, line))
+    {
+        std::istringstream fields(line);
+        std::string input, output, type = typeNames[options.keyType], extra;
+        if (!(fields >> input) || input[0] == '#')
+        {
+            continue;
+        }
+
+        KeyType keyType;
+        if (!(fields >> output) || (fields >> type && !parseKeyType(type, keyType)) || fields >> extra)
+        {
+            std::cerr << "Invalid job: " << line << std::endl;
+            continue;
+        }
+        if (input != "-" && access(input.c_str(), R_OK) != 0)
+        {
+            std::cerr << "Failed to open file: " << input << std::endl;
+            continue;
+        }
+        return input + "\n" + output + "\n" + type;
+    }
+    return "";
+}
+
+
+#ifdef PMS_TRACE
+/**
+ * void StageTrace::begin(int stage, double origin)
+ * 
+ * @brief Start the instrumentation of a stage and make it the stage of the calling thread.
+ * 
+ * @param stage Index of the stage.
+ * @param origin Start of the run (MPI_Wtime), all times are relative to it.
+ * 
+ * @return void
+ * 
+*/
+void StageTrace::begin(int stage, double origin)
+{
+    summary.stage = stage;
+    this->origin = origin;
+    summary.total = MPI_Wtime() - origin;
+    stageTrace = this;
+}
+
+
+/**
+ * void StageTrace::end()
+ * 
+ * @brief Stop the instrumentation of the stage.
+ * 
+ * @return void
+ * 
+ * Until end() summary.total holds the start of the stage, afterwards its duration.
+ * 
+*/
+void StageTrace::end()
+{
+    summary.total = MPI_Wtime() - origin - summary.total;
+    stageTrace = nullptr;
+}
+
+
+/**
+ * void StageTrace::wait(int kind, double start, double stop)
+ * 
+ * @brief Add a blocked interval to the stage.
+ * 
+ * @param kind TRACE_RECV or TRACE_SEND.
+ * @param start Start of the interval (MPI_Wtime).
+ * @param stop End of the interval (MPI_Wtime).
+ * 
+ * @return void
+ * 
+ * Short intervals only count to the totals, so the timeline stays small.
+ * 
+*/
+void StageTrace::wait(int kind, double start, double stop)
+{
+    double duration = stop - start;
+    (kind == TRACE_RECV ? summary.recvWait : summary.sendWait) += duration;
+
+    if (duration >= TRACE_MIN_EVENT && events.size() < TRACE_MAX_EVENTS)
+    {
+        events.push_back({start - origin, duration, kind});
+    }
+}
+
+
+/**
+ * void writeTrace(const std::string &path, const std::vector<StageSummary> &summaries,
+ *                 const std::vector<std::vector<TraceEvent>> &events)
+ * 
+ * @brief Write the Chrome trace of all stages and print the summary table to stderr.
+ * 
+ * @param path Path of the trace file (JSON, open in chrome://tracing or Perfetto).
+ * @param summaries Counters of the stages.
+ * @param events Blocked intervals of the stages.
+ * 
+ * @return void
+ * 
+*/
+void writeTrace(const std::string &path, const std::vector<StageSummary> &summaries,
+                const std::vector<std::vector<TraceEvent>> &events)
+{
+    static const char *kindNames[] = {"recv wait", "send wait"};
+
+    FILE *file = fopen(path.c_str(), "w");
+    if (!file)
+    {
+        std::cerr << "Failed to open trace file." << std::endl;
+    }
+    else
+    {
+        fprintf(file, "{\"traceEvents\":[\n");
+        bool first = true;
+        for (size_t i = 0; i < summaries.size(); i++)
+        {
+            const StageSummary &stage = summaries[i];
+            fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%d,\"args\":{\"name\":\"stage %d\"}}",
+                    first ? "" : ",\n", stage.stage, stage.stage);
+            first = false;
+            for (const TraceEvent &event : events[i])
+            {
+                fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                        kindNames[event.kind], stage.stage, event.start * 1e6, event.duration * 1e6);
+            }
+        }
+        fprintf(file, "\n],\n\"stages\":[\n");
+        for (size_t i = 0; i < summaries.size(); i++)
+        {
+            const StageSummary &stage = summaries[i];
+            fprintf(file,
+                    "%s{\"stage\":%d,\"elementsReceived\":%llu,\"elementsSent\":%llu,\"messagesReceived\":%llu,"
+                    "\"messagesSent\":%llu,\"maxTop\":%llu,\"maxBottom\":%llu,\"batches\":%llu,"
+                    "\"total\":%.9f,\"recvWait\":%.9f,\"sendWait\":%.9f,\"work\":%.9f}",
+                    i == 0 ? "" : ",\n", stage.stage, (unsigned long long)stage.elementsReceived,
+                    (unsigned long long)stage.elementsSent, (unsigned long long)stage.messagesReceived,
+                    (unsigned long long)stage.messagesSent, (unsigned long long)stage.maxTop,
+                    (unsigned long long)stage.maxBottom, (unsigned long long)stage.batches, stage.total,
+                    stage.recvWait, stage.sendWait, stage.total - stage.recvWait - stage.sendWait);
+        }
+        fprintf(file, "\n]}\n");
+        fclose(file);
+    }
+
+    fprintf(stderr, "%5s %12s %12s %10s %10s %10s %10s %9s %10s %10s %10s %10s\n", "stage", "elem recv",
+            "elem sent", "msg recv", "msg sent", "max top", "max bottom", "batches", "total [s]", "recv [s]",
+            "send [s]", "work [s]");
+    for (const StageSummary &stage : summaries)
+    {
+        fprintf(stderr, "%5d %12llu %12llu %10llu %10llu %10llu %10llu %9llu %10.4f %10.4f %10.4f %10.4f\n",
+                stage.stage, (unsigned long long)stage.elementsReceived, (unsigned long long)stage.elementsSent,
+                (unsigned long long)stage.messagesReceived, (unsigned long long)stage.messagesSent,
+                (unsigned long long)stage.maxTop, (unsigned long long)stage.maxBottom,
+                (unsigned long long)stage.batches, stage.total, stage.recvWait, stage.sendWait,
+                stage.total - stage.recvWait - stage.sendWait);
+    }
+}
+
+
+/**
+ * void gatherTrace(int procID, int noProc, StageTrace &trace, const std::string &path)
+ * 
+ * @brief Collect the instrumentation of all processes on the first one and write it.
+ * 
+ * @param procID The process ID.
+ * @param noProc The number of processes.
+ * @param trace Instrumentation of this process.
+ * @param path Path of the trace file.
+ * 
+ * @return void
+ * 
+*/
+void gatherTrace(int procID, int noProc, StageTrace &trace, const std::string &path)
+{
+    std::vector<StageSummary> summaries(procID == 0 ? noProc : 0);
+    MPI_Gather(&trace.summary, sizeof(StageSummary), MPI_BYTE, summaries.data(), sizeof(StageSummary), MPI_BYTE,
+               0, MPI_COMM_WORLD);
+
+    int bytes = trace.events.size() * sizeof(TraceEvent);
+    std::vector<int> counts(noProc), displs(noProc);
+    MPI_Gather(&bytes, 1, MPI_INT, counts.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
+    int totalBytes = 0;
+    for (int i = 0; i < noProc; i++)
+    {
+        displs[i] = totalBytes;
+        totalBytes += counts[i];
+    }
+    std::vector<TraceEvent> all(procID == 0 ? totalBytes / sizeof(TraceEvent) : 0);
+    MPI_Gatherv(trace.events.data(), bytes, MPI_BYTE, all.data(), counts.data(), displs.data(), MPI_BYTE, 0,
+                MPI_COMM_WORLD);
+
+    if (procID == 0)
+    {
+        std::vector<std::vector<TraceEvent>> events(noProc);
+        for (int i = 0; i < noProc; i++)
+        {
+            events[i].assign(all.begin() + displs[i] / sizeof(TraceEvent),
+                             all.begin() + (displs[i] + counts[i]) / sizeof(TraceEvent));
+        }
+        writeTrace(path, summaries, events);
+    }
+}
+#endif
+
+
+/**
+ * void runSort<T>(int procID, int noProc, const PmsOptions &options)
+ * 
+ * @brief Run this process's part of the selected sorting engine for elements of type T.
+ * 
+ * @param procID The process ID.
+ * @param noProc The number of processes.
+ * @param options Program options.
+ * 
+ * @return void
+ * 
+*/
+template <typename T>
+void runSort(int procID, int noProc, const PmsOptions &options)
+{
+    if (options.engine == ENGINE_SAMPLE)
+    {
+        sampleSort<T>(procID, noProc, options);
+    }
+    else if (options.engine == ENGINE_SERIAL)
+    {
+        serialSort<T>(options);
+    }
+    else if (options.threads > 0)
+    {
+        runThreads<T>(options);
+    }
+    else
+    {
+#ifdef PMS_TRACE
+        // The service mode traces all its jobs at once (runService)
+        const bool traceJob = options.jobQueue.empty();
+        StageTrace trace;
+        if (traceJob)
+        {
+            MPI_Barrier(MPI_COMM_WORLD);
+            trace.begin(procID, MPI_Wtime());
+        }
+#endif
+        if (procID == 0)
+        {
+            StreamSender<T> sender(procID + 1, options.chunkSize, options.window);
+            processFirst<T>(options, sender);
+        }
+        else
+        {
+            // Streams from the previous and to the next process, the last process writes the output
+            StreamReceiver<T> receiver(procID - 1, options.chunkSize, options.window);
+            StreamSender<T> sender(procID + 1, options.chunkSize, options.window);
+            std::unique_ptr<OutputWriter<T>> writer;
+            if (procID == noProc - 1)
+            {
+                writer = std::make_unique<OutputWriter<T>>(options.outputPath, options.outputFormat);
+            }
+            processOthers<T>(procID, noProc, options, receiver, sender, writer.get());
+        }
+#ifdef PMS_TRACE
+        if (traceJob)
+        {
+            trace.end();
+            gatherTrace(procID, noProc, trace, options.tracePath);
+        }
+#endif
+    }
+}
+
+
+/**
+ * void runThreads<T>(const PmsOptions &options)
+ * 
+ * @brief Run the whole pipeline in this process, every stage in its own thread.
+ * 
+ * @param options Program options.
+ * 
+ * @return void
+ * 
+ * Stage i runs the same processFirst/processOthers code as process i of the MPI backend,
+ * only the streams are SpscRings. The rings hold `chunk * window` elements with -b,
+ * THREAD_RING_CAPACITY otherwise (rounded up to a power of two).
+ * 
+ * The unsorted numbers and the result may both go to the standard output, so the last stage
+ * keeps its output in memory until the first stage has printed all numbers.
+ * 
+*/
+template <typename T>
+void runThreads(const PmsOptions &options)
+{
+    const int noStages = options.threads;
+    size_t capacity = options.chunkSize > 0 ? size_t(options.chunkSize) * options.window : THREAD_RING_CAPACITY;
+
+    std::vector<std::unique_ptr<SpscRing<T>>> rings;
+    for (int i = 0; i < noStages - 1; i++)
+    {
+        rings.push_back(std::make_unique<SpscRing<T>>(capacity));
+    }
+
+    OutputWriter<T> writer(options.outputPath, options.outputFormat);
+    std::atomic<bool> echoDone{false};
+    if (options.echo && options.outputPath == "-")
+    {
+        writer.holdUntil(&echoDone);
+    }
+
+#ifdef PMS_TRACE
+    std::vector<StageTrace> traces(noStages);
+    const double origin = MPI_Wtime();
+#endif
+
+    std::vector<std::thread> stages;
+    for (int stage = 0; stage < noStages; stage++)
+    {
+        auto runStage = [&, stage]()
+        {
+#ifdef PMS_TRACE
+            traces[stage].begin(stage, origin);
+#endif
+            if (stage == 0)
+            {
+                RingSender<T> sender(rings[0].get());
+                processFirst<T>(options, sender);
+                echoDone.store(true, std::memory_order_release);
+            }
+            else
+            {
+                RingReceiver<T> receiver(rings[stage - 1].get());
+                RingSender<T> sender(stage < noStages - 1 ? rings[stage].get() : nullptr);
+                processOthers<T>(stage, noStages, options, receiver, sender, stage == noStages - 1 ? &writer : nullptr);
+            }
+#ifdef PMS_TRACE
+            traces[stage].end();
+#endif
+        };
+        stages.emplace_back(runStage);
+
+        if (options.pinThreads)
+        {
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            CPU_SET(stage % std::max(1u, std::thread::hardware_concurrency()), &cpus);
+            pthread_setaffinity_np(stages.back().native_handle(), sizeof(cpus), &cpus);
+        }
+    }
+
+    for (auto &thread : stages)
+    {
+        thread.join();
+    }
+
+#ifdef PMS_TRACE
+    std::vector<StageSummary> summaries;
+    std::vector<std::vector<TraceEvent>> events;
+    for (StageTrace &trace : traces)
+    {
+        summaries.push_back(trace.summary);
+        events.push_back(std::move(trace.events));
+    }
+    writeTrace(options.tracePath, summaries, events);
+#endif
+}
+
+
+template <typename T>
+StreamSender<T>::StreamSender(int dest, int chunkSize, int window)
+    : dest(dest), chunkSize(chunkSize), window(window), credits(window)
+{
+    if (chunkSize > 0)
+    {
+        buffers.assign(window, std::vector<uint8_t>(sizeof(BlockHeader) + chunkSize * sizeof(T)));
+        requests.assign(window, MPI_REQUEST_NULL);
+    }
+}
+
+
+/**
+ * void StreamSender<T>::send(const T &num)
+ * 
+ * @brief Send one number (or append it to the current block).
+ * 
+ * @param num The number to send.
+ * 
+ * @return void
+ * 
+*/
+template <typename T>
+void StreamSender<T>::send(const T &num)
+{
+    if (chunkSize == 0)
+    {
+        TRACE_WAIT(TRACE_SEND);
+        TRACE_COUNT(messagesSent, 1);
+        MPI_Send(&num, 1, PmsTraits<T>::mpiType(), dest, MSG_TAG, MPI_COMM_WORLD);
+        return;
+    }
+
+    std::memcpy(buffers[current].data() + sizeof(BlockHeader) + count++ * sizeof(T), &num, sizeof(T));
+    if (count == static_cast<uint32_t>(chunkSize))
+    {
+        flush(0);
+    }
+}
+
+
+/**
+ * void StreamSender<T>::close()
+ * 
+ * @brief Signal the end of the stream to the next process.
+ * 
+ * @return void
+ * 
+ * In block mode the remaining numbers are sent in the final block (which may be empty).
+ * The function then waits until all blocks were sent and the receiver returned all credits,
+ * so no message of the stream is left behind.
+ * 
+*/
+template <typename T>
+void StreamSender<T>::close()
+{
+    if (chunkSize == 0)
+    {
+        TRACE_WAIT(TRACE_SEND);
+        TRACE_COUNT(messagesSent, 1);
+        T dummy{};
+        MPI_Send(&dummy, 1, PmsTraits<T>::mpiType(), dest, MSG_FINAL, MPI_COMM_WORLD);
+        return;
+    }
+
+    flush(BLOCK_FLAG_FINAL);
+    TRACE_WAIT(TRACE_SEND);
+    MPI_Waitall(window, requests.data(), MPI_STATUSES_IGNORE);
+    while (credits < window)
+    {
+        MPI_Recv(nullptr, 0, MPI_BYTE, dest, MSG_CREDIT, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        credits++;
+    }
+}
+
+
+/**
+ * void StreamSender<T>::flush(uint32_t flags)
+ * 
+ * @brief Start sending the buffered numbers as one block and switch to the next buffer.
+ * 
+ * @param flags Flags for the block header.
+ * 
+ * @return void
+ * 
+ * A block may only be sent with a credit, without one the function waits until the receiver
+ * frees one of its buffers. The next buffer is reused once its previous send has completed.
+ * 
+*/
+template <typename T>
+void StreamSender<T>::flush(uint32_t flags)
+{
+    TRACE_WAIT(TRACE_SEND);
+    TRACE_COUNT(messagesSent, 1);
+    if (credits == 0)
+    {
+        MPI_Recv(nullptr, 0, MPI_BYTE, dest, MSG_CREDIT, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        credits++;
+    }
+
+    BlockHeader header{count, flags};
+    std::memcpy(buffers[current].data(), &header, sizeof(header));
+    MPI_Isend(buffers[current].data(), sizeof(header) + count * sizeof(T), MPI_BYTE, dest, MSG_BLOCK,
+              MPI_COMM_WORLD, &requests[current]);
+    credits--;
+    count = 0;
+
+    current = (current + 1) % window;
+    MPI_Wait(&requests[current], MPI_STATUS_IGNORE);
+}
+
+
+template <typename T>
+StreamReceiver<T>::StreamReceiver(int source, int chunkSize, int window)
+    : source(source), chunkSize(chunkSize), window(window)
+{
+    if (chunkSize > 0)
+    {
+        // All buffers wait for blocks from the beginning, so the next block arrives while the current one is used
+        buffers.assign(window, std::vector<uint8_t>(sizeof(BlockHeader) + chunkSize * sizeof(T)));
+        requests.assign(window, MPI_REQUEST_NULL);
+        for (int i = 0; i < window; i++)
+        {
+            post(i);
+        }
+    }
+}
+
+
+/**
+ * bool StreamReceiver<T>::receive(T &num)
+ * 
+ * @brief Receive the next number of the stream.
+ * 
+ * @param num The received number.
+ * 
+ * @return false if the stream has ended (num is not set), true otherwise.
+ * 
+*/
+template <typename T>
+bool StreamReceiver<T>::receive(T &num)
+{
+    if (chunkSize == 0)
+    {
+        TRACE_WAIT(TRACE_RECV);
+        TRACE_COUNT(messagesReceived, 1);
+        MPI_Status status;
+        MPI_Recv(&num, 1, PmsTraits<T>::mpiType(), source, MPI_ANY_TAG, MPI_COMM_WORLD, &status);
+        return status.MPI_TAG != MSG_FINAL;
+    }
+
+    // Take blocks until there is a number to take (or the stream has ended)
+    while (position == count)
+    {
+        if (finished)
+        {
+            release();
+            return false;
+        }
+
+        // The used buffer goes back to the sender as a credit
+        if (active)
+        {
+            MPI_Send(nullptr, 0, MPI_BYTE, source, MSG_CREDIT, MPI_COMM_WORLD);
+            post(current);
+            current = (current + 1) % window;
+        }
+
+        BlockHeader header;
+        {
+            TRACE_WAIT(TRACE_RECV);
+            TRACE_COUNT(messagesReceived, 1);
+            MPI_Wait(&requests[current], MPI_STATUS_IGNORE);
+        }
+        std::memcpy(&header, buffers[current].data(), sizeof(header));
+        count = header.count;
+        position = 0;
+        finished = header.flags & BLOCK_FLAG_FINAL;
+        active = true;
+    }
+
+    std::memcpy(&num, buffers[current].data() + sizeof(BlockHeader) + position++ * sizeof(T), sizeof(T));
+    return true;
+}
+
+
+/**
+ * void StreamReceiver<T>::post(int index)
+ * 
+ * @brief Start receiving the next block into the given buffer.
+ * 
+ * @param index Index of the buffer.
+ * 
+ * @return void
+ * 
+*/
+template <typename T>
+void StreamReceiver<T>::post(int index)
+{
+    MPI_Irecv(buffers[index].data(), buffers[index].size(), MPI_BYTE, source, MSG_BLOCK, MPI_COMM_WORLD,
+              &requests[index]);
+}
+
+
+/**
+ * void StreamReceiver<T>::release()
+ * 
+ * @brief Cancel the receives that will never be matched and return the credit of the final block.
+ * 
+ * @return void
+ * 
+*/
+template <typename T>
+void StreamReceiver<T>::release()
+{
+    if (!active)
+    {
+        return;
+    }
+
+    // Cancel before the last credit, after it the sender may start the next stream (service mode)
+    for (int i = 0; i < window; i++)
+    {
+        if (i != current && requests[i] != MPI_REQUEST_NULL)
+        {
+            MPI_Cancel(&requests[i]);
+            MPI_Wait(&requests[i], MPI_STATUS_IGNORE);
+        }
+    }
+    MPI_Send(nullptr, 0, MPI_BYTE, source, MSG_CREDIT, MPI_COMM_WORLD);
+    active = false;
+}
+
+
+template <typename T>
+InputReader<T>::InputReader(const std::string &path)
+{
+    fd = path == "-" ? STDIN_FILENO : open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        std::cerr << "Failed to open file." << std::endl;
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    // Map regular files, fall back to buffered reading if that is not possible
+    struct stat info;
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0)
+    {
+        void *address = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (address != MAP_FAILED)
+        {
+            madvise(address, info.st_size, MADV_SEQUENTIAL);
+            mapped = static_cast<const uint8_t *>(address);
+            size = info.st_size;
+            return;
+        }
+    }
+
+    buffer.resize(IO_BUFFER_SIZE);
+}
+
+
+template <typename T>
+InputReader<T>::~InputReader()
+{
+    if (mapped)
+    {
+        munmap(const_cast<uint8_t *>(mapped), size);
+    }
+    if (fd > STDIN_FILENO)
+    {
+        ::close(fd);
+    }
+}
+
+
+/**
+ * bool InputReader<T>::read(T &num)
+ * 
+ * @brief Read the next element of the file.
+ * 
+ * @param num The read element.
+ * 
+ * @return false at the end of the file (num is not set), true otherwise.
+ * 
+*/
+template <typename T>
+bool InputReader<T>::read(T &num)
+{
+    if (size - position < sizeof(T) && (mapped || !refill()))
+    {
+        return false;
+    }
+
+    const uint8_t *data = mapped ? mapped : buffer.data();
+    std::memcpy(&num, data + position, sizeof(T));
+    position += sizeof(T);
+    return true;
+}
+
+
+/**
+ * bool InputReader<T>::refill()
+ * 
+ * @brief Move the unread bytes to the start of the buffer and read more data after them.
+ * 
+ * @return true if the buffer holds at least one whole element.
+ * 
+*/
+template <typename T>
+bool InputReader<T>::refill()
+{
+    size_t remaining = size - position;
+    std::memmove(buffer.data(), buffer.data() + position, remaining);
+    size = remaining;
+    position = 0;
+
+    while (size < sizeof(T))
+    {
+        ssize_t bytes = ::read(fd, buffer.data() + size, buffer.size() - size);
+        if (bytes < 0)
+        {
+            std::cerr << "Failed to read file." << std::endl;
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        if (bytes == 0)
+        {
+            return false;
+        }
+        size += bytes;
+    }
+
+    return true;
+}
+
+
+template <typename T>
+OutputWriter<T>::OutputWriter(const std::string &path, OutputFormat format)
+    : format(format), buffer(IO_BUFFER_SIZE)
+{
+    file = path == "-" ? stdout : fopen(path.c_str(), format == OUT_BINARY ? "wb" : "w");
+    if (!file)
+    {
+        std::cerr << "Failed to open output file." << std::endl;
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+}
+
+
+template <typename T>
+OutputWriter<T>::~OutputWriter()
+{
+    close();
+}
+
+
+/**
+ * void OutputWriter<T>::write(const T &num)
+ * 
+ * @brief Append one element to the output.
+ * 
+ * @param num The element to write.
+ * 
+ * @return void
+ * 
+*/
+template <typename T>
+void OutputWriter<T>::write(const T &num)
+{
+    if (buffer.size() - count < FORMAT_BUFFER_SIZE + 1)
+    {
+        if (held())
+        {
+            buffer.resize(buffer.size() * 2);
+        }
+        else
+        {
+            flush();
+        }
+    }
+
+    if (format == OUT_BINARY)
+    {
+        std::memcpy(buffer.data() + count, &num, sizeof(T));
+        count += sizeof(T);
+    }
+    else
+    {
+        char *end = PmsTraits<T>::format(buffer.data() + count, buffer.data() + buffer.size(), num);
+        *end++ = '\n';
+        count = end - buffer.data();
+    }
+}
+
+
+/**
+ * void OutputWriter<T>::close()
+ * 
+ * @brief Flush the buffer and close the output file.
+ * 
+ * @return void
+ * 
+ * The text output ends with an empty line like the output of the original program.
+ * 
+*/
+template <typename T>
+void OutputWriter<T>::close()
+{
+    if (!file)
+    {
+        return;
+    }
+
+    while (held())
+    {
+        std::this_thread::yield();
+    }
+    flush();
+    if (format == OUT_TEXT)
+    {
+        fputc('\n', file);
+    }
+
+    if (file == stdout)
+    {
+        fflush(file);
+    }
+    else if (fclose(file) != 0)
+    {
+        std::cerr << "Failed to write output file." << std::endl;
+    }
+    file = nullptr;
+}
+
+
+/**
+ * void OutputWriter<T>::flush()
+ * 
+ * @brief Write the buffered data to the file.
+ * 
+ * @return void
+ * 
+*/
+template <typename T>
+void OutputWriter<T>::flush()
+{
+    if (count > 0 && fwrite(buffer.data(), 1, count, file) != count)
+    {
+        std::cerr << "Failed to write output file." << std::endl;
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    count = 0;
+}
+
+
+/**
+ * void OutputWriter<T>::holdUntil(const std::atomic<bool> *released)
+ * 
+ * @brief Do not write anything until the flag is set (used by the thread backend).
+ * 
+ * @param released The flag, set by another thread.
+ * 
+ * @return void
+ * 
+*/
+template <typename T>
+void OutputWriter<T>::holdUntil(const std::atomic<bool> *released)
+{
+    this->released = released;
+}
+
+
+template <typename T>
+SpscRing<T>::SpscRing(size_t capacity)
+{
+    size_t size = 1;
+    while (size < capacity)
+    {
+        size <<= 1;
+    }
+    slots.resize(size);
+    mask = size - 1;
+}
+
+
+/**
+ * void SpscRing<T>::push(const T &num)
+ * 
+ * @brief Append a number, wait while the ring is full (producer only).
+ * 
+ * @param num The number.
+ * 
+ * @return void
+ * 
+*/
+template <typename T>
+void SpscRing<T>::push(const T &num)
+{
+    const size_t position = tail.load(std::memory_order_relaxed);
+    if (position - cachedHead == slots.size())
+    {
+        TRACE_WAIT(TRACE_SEND);
+        for (int spins = 0; position - cachedHead == slots.size(); spins++)
+        {
+            cachedHead = head.load(std::memory_order_acquire);
+            if (spins >= SPIN_COUNT)
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
+    TRACE_COUNT(messagesSent, 1);
+
+    slots[position & mask] = num;
+    tail.store(position + 1, std::memory_order_release);
+}
+
+
+/**
+ * void SpscRing<T>::close()
+ * 
+ * @brief Mark the end of the stream (producer only).
+ * 
+ * @return void
+ * 
+*/
+template <typename T>
+void SpscRing<T>::close()
+{
+    closed.store(true, std::memory_order_release);
+}
+
+
+/**
+ * bool SpscRing<T>::pop(T &num)
+ * 
+ * @brief Take the next number, wait while the ring is empty (consumer only).
+ * 
+ * @param num The number.
+ * 
+ * @return false if the ring is empty and closed (num is not set), true otherwise.
+ * 
+*/
+template <typename T>
+bool SpscRing<T>::pop(T &num)
+{
+    const size_t position = head.load(std::memory_order_relaxed);
+    if (position == cachedTail)
+    {
+        TRACE_WAIT(TRACE_RECV);
+        for (int spins = 0; position == cachedTail; spins++)
+        {
+            // The flag is read before the index, so no number pushed before close() is missed
+            bool isClosed = closed.load(std::memory_order_acquire);
+            cachedTail = tail.load(std::memory_order_acquire);
+            if (position == cachedTail && isClosed)
+            {
+                return false;
+            }
+            if (spins >= SPIN_COUNT)
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
+    TRACE_COUNT(messagesReceived, 1);
+
+    num = slots[position & mask];
+    head.store(position + 1, std::memory_order_release);
+    return true;
+}
+
+
+/**
+ * SpillQueue<T>::SpillQueue(size_t memoryLimit, const std::string &tempDir)
+ * 
+ * @brief Create an empty queue.
+ * 
+ * @param memoryLimit Bytes the queue may keep in memory (0 = unlimited).
+ * @param tempDir Directory for the temporary file.
+ * 
+*/
+template <typename T>
+SpillQueue<T>::SpillQueue(size_t memoryLimit, const std::string &tempDir)
+    : tempDir(tempDir)
+{
+    if (memoryLimit == 0)
+    {
+        headCapacity = SIZE_MAX;
+        blockSize = 0;
+        return;
+    }
+
+    // A quarter of the memory is the spill block, the rest is the head
+    blockSize = std::max<size_t>(1, std::min(IO_BUFFER_SIZE, memoryLimit / 4) / sizeof(T));
+    headCapacity = std::max<size_t>(blockSize, memoryLimit / sizeof(T) - blockSize);
+    tail.reserve(blockSize);
+}
+
+
+template <typename T>
+SpillQueue<T>::~SpillQueue()
+{
+    if (fd >= 0)
+    {
+        ::close(fd);
+    }
+}
+
+
+/**
+ * void SpillQueue<T>::push_back(const T &num)
+ * 
+ * @brief Append an element to the end of the queue.
+ * 
+ * @param num The element.
+ * 
+ * @return void
+ * 
+*/
+template <typename T>
+void SpillQueue<T>::push_back(const T &num)
+{
+    length++;
+
+    // Elements may go to the head only if nothing older is waiting in the file or in the tail
+    if (readOffset == writeOffset && tail.empty() && head.size() < headCapacity)
+    {
+        head.push_back(num);
+        return;
+    }
+
+    tail.push_back(num);
+    if (tail.size() == blockSize)
+    {
+        spill();
+    }
+}
+
+
+/**
+ * void SpillQueue<T>::pop_front()
+ * 
+ * @brief Remove the first element of the queue.
+ * 
+ * @return void
+ * 
+*/
+template <typename T>
+void SpillQueue<T>::pop_front()
+{
+    length--;
+    head.pop_front();
+    if (head.empty())
+    {
+        load();
+    }
+}
+
+
+/**
+ * void SpillQueue<T>::spill()
+ * 
+ * @brief Append the tail to the temporary file.
+ * 
+ * @return void
+ * 
+*/
+template <typename T>
+void SpillQueue<T>::spill()
+{
+    if (fd < 0)
+    {
+        std::string path = tempDir + "/pms-spill-XXXXXX";
+        fd = mkstemp(path.data());
+        if (fd < 0)
+        {
+            std::cerr << "Failed to create temporary file in " << tempDir << "." << std::endl;
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        unlink(path.c_str());
+    }
 
-// Function prototypes
-void processFirst(int procID);
-void processOthers(int procID, int noProc);
+    size_t bytes = tail.size() * sizeof(T);
+    if (pwrite(fd, tail.data(), bytes, writeOffset) != static_cast<ssize_t>(bytes))
+    {
+        std::cerr << "Failed to write temporary file." << std::endl;
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    writeOffset += bytes;
+    tail.clear();
+}
 
 
-int main(int argc, char *argv[])
+/**
+ * void SpillQueue<T>::load()
+ * 
+ * @brief Refill the empty head from the file (or from the tail if the file is empty).
+ * 
+ * @return void
+ * 
+*/
+template <typename T>
+void SpillQueue<T>::load()
 {
-    MPI_Init(&argc, &argv);
-
-    int procID, noProc;
-    MPI_Comm_rank(MPI_COMM_WORLD, &procID);
-    MPI_Comm_size(MPI_COMM_WORLD, &noProc);
+    if (readOffset == writeOffset)
+    {
+        head.insert(head.end(), tail.begin(), tail.end());
+        tail.clear();
+        return;
+    }
 
-    if (noProc < 2)
+    size_t count = std::min<uint64_t>(blockSize, (writeOffset - readOffset) / sizeof(T));
+    std::vector<T> block(count);
+    if (pread(fd, block.data(), count * sizeof(T), readOffset) != static_cast<ssize_t>(count * sizeof(T)))
     {
-        std::cerr << "This program requires at least 2 MPI processes." << std::endl;
+        std::cerr << "Failed to read temporary file." << std::endl;
         MPI_Abort(MPI_COMM_WORLD, 1);
     }
+    head.insert(head.end(), block.begin(), block.end());
+    readOffset += count * sizeof(T);
 
-    if (procID == 0)
+    // The file is empty again, start from its beginning and drop the old data
+    if (readOffset == writeOffset)
     {
-        processFirst(procID);
+        readOffset = writeOffset = 0;
+        if (ftruncate(fd, 0) != 0)
+        {
+            std::cerr << "Failed to truncate temporary file." << std::endl;
+        }
     }
-    else
+}
+
+
+/**
+ * void sortRun<T>(std::vector<T> &run, std::vector<T> &scratch)
+ * 
+ * @brief Sort one block of numbers on the first process.
+ * 
+ * @param run The numbers to sort (sorted in place).
+ * @param scratch Buffer of the same type reused between the calls.
+ * 
+ * @return void
+ * 
+ * LSD radix sort over the bytes of PmsTraits<T>::radixKey, a pass is skipped when all numbers
+ * share the byte. The sort is stable, so equal keys keep their input order like in the pipeline.
+ * 
+*/
+template <typename T>
+void sortRun(std::vector<T> &run, std::vector<T> &scratch)
+{
+    if (run.size() < RADIX_SORT_THRESHOLD)
     {
-        processOthers(procID, noProc);
+        std::stable_sort(run.begin(), run.end(), PmsTraits<T>::less);
+        return;
     }
 
-    MPI_Finalize();
-    return 0;
+    scratch.resize(run.size());
+    for (int byte = 0; byte < PmsTraits<T>::RADIX_BYTES; byte++)
+    {
+        const int shift = 8 * byte;
+        size_t offsets[256] = {};
+        for (const T &num : run)
+        {
+            offsets[(PmsTraits<T>::radixKey(num) >> shift) & 0xFF]++;
+        }
+
+        if (offsets[(PmsTraits<T>::radixKey(run[0]) >> shift) & 0xFF] == run.size())
+        {
+            continue;
+        }
+
+        size_t sum = 0;
+        for (size_t &offset : offsets)
+        {
+            size_t count = offset;
+            offset = sum;
+            sum += count;
+        }
+
+        for (const T &num : run)
+        {
+            scratch[offsets[(PmsTraits<T>::radixKey(num) >> shift) & 0xFF]++] = num;
+        }
+        run.swap(scratch);
+    }
 }
 
 
 /**
- * void processFirst(int procID)
+ * void processFirst<T>(const PmsOptions &options, Sender &sender)
  * 
  * @brief Process the first process in the pipeline.
  * 
- * @param procID The process ID.
+ * @param options Program options.
+ * @param sender Stream to the next process (StreamSender or RingSender).
  * 
  * @return void
  * 
  * This function reads the numbers from the file and sends them to the next process in the pipeline.
+ * With -r k the numbers are first sorted in blocks of 2^k, so the next process gets sorted runs.
  * The function also sends an EOF value to indicate the end of the file.
  * 
- * The function also prints the numbers to the console.
+ * The function also prints the numbers to the console (unless disabled by -q).
  * 
 */
-void processFirst(int procID)
+template <typename T, typename Sender>
+void processFirst(const PmsOptions &options, Sender &sender)
 {
-    std::ifstream inputFile("numbers", std::ios::binary);
-    if (!inputFile)
+    InputReader<T> reader(options.inputPath);
+    // Block of numbers for the presort and its scratch buffer
+    const size_t runLength = size_t(1) << options.presortExponent;
+    std::vector<T> run, scratch;
+
+    auto sendRun = [&]()
     {
-        std::cerr << "Failed to open file." << std::endl;
-        MPI_Abort(MPI_COMM_WORLD, 1);
-    }
+        sortRun(run, scratch);
+        for (const T &num : run)
+        {
+            sender.send(num);
+        }
+        run.clear();
+    };
 
-    uint8_t num;
-    while (inputFile.read(reinterpret_cast<char *>(&num), sizeof(num)))
+    T num;
+    while (reader.read(num))
+    {
+        if (options.echo)
+        {
+            PmsTraits<T>::print(std::cout, num);
+            std::cout << " ";
+        }
+
+        TRACE_COUNT(elementsSent, 1);
+        if (runLength == 1)
+        {
+            sender.send(num);
+            continue;
+        }
+
+        run.push_back(num);
+        if (run.size() == runLength)
+        {
+            sendRun();
+        }
+    }
+    if (!run.empty())
+    {
+        sendRun();
+    }
+    if (options.echo)
     {
-        std::cout << static_cast<unsigned int>(num) << " ";
-        MPI_Send(&num, 1, MPI_UNSIGNED_CHAR, 1, MSG_TAG, MPI_COMM_WORLD);
+        std::cout << std::endl;
     }
-    std::cout << std::endl;
 
     // Send EOF value to indicate the end of file
-    MPI_Send(&num, 1, MPI_UNSIGNED_CHAR, 1, MSG_FINAL, MPI_COMM_WORLD);
-
-    inputFile.close();
+    sender.close();
 }
 
 
 /**
- * void processOthers(int procID, int noProc)
+ * void processOthers<T>(int procID, int noProc, const PmsOptions &options, Receiver &receiver, Sender &sender,
+ *                       OutputWriter<T> *writer)
  * 
  * @brief Process the other processes in the pipeline.
  * 
  * @param procID The process ID.
  * @param noProc The number of processes.
+ * @param options Program options.
+ * @param receiver Stream from the previous process (StreamReceiver or RingReceiver).
+ * @param sender Stream to the next process (not used by the last process).
+ * @param writer Output of the last process (nullptr for the others).
  * 
  * @return void
  * 
  * This function receives the numbers from the previous process in the pipeline.
- * The function sorts the numbers and sends them to the next process in the pipeline.
- * This is done within batches of numbers.
+ * The incoming stream consists of sorted runs of 2^(procID - 1 + k) numbers (only the last run may be shorter),
+ * k is the presort exponent given by -r (0 by default).
+ * Runs are alternately stored to the top and bottom queue, each top run is merged with the following
+ * bottom run and the merged run is sent to the next process in the pipeline.
+ * 
+ * With -m the queues keep only a part of the runs in memory and spill the rest to temporary files,
+ * every stage is then a streaming two-way merge with bounded memory.
+ * 
+ * The merge only compares the heads of the two queues. A head may be sent once the other queue either has
+ * its head available or has no more numbers for the current batch, so every number costs O(1) and the
+ * input does not have to be a power of two long.
  * The function also sends an EOF value to indicate the end of the file.
  * 
 */
-void processOthers(int procID, int noProc)
+template <typename T, typename Receiver, typename Sender>
+void processOthers(int procID, int noProc, const PmsOptions &options, Receiver &receiver, Sender &sender,
+                   OutputWriter<T> *writer)
 {
-    // Deques for the top and bottom queues (and final numbers to be printed)
-    std::deque<uint8_t> qTop, qBottom, finalNumbers;
-    bool shouldIReceive = true, initCond = false, newBatch = true;
-    uint8_t num, sendNum, sentItemsB = 0, sentItemsT = 0;
+    // Queues for the top and bottom runs, each gets half of the memory limit
+    SpillQueue<T> qTop(options.memoryLimit / 2, options.tempDir), qBottom(options.memoryLimit / 2, options.tempDir);
+    bool upstreamDone = false;
+    // Length of one incoming run
+    const uint64_t runLength = uint64_t(1) << (procID - 1 + options.presortExponent);
+    // Numbers received into the current run, numbers taken from the current batch of each queue
+    uint64_t cntRecv = 0, takenT = 0, takenB = 0;
     // Initial queue position is top
     QueuePosition recvQueue = Q_TOP;
-    // Number of items needed in the top queue
-    int condNeededItemsInTQ = pow(2, procID - 1), cntRecv = 0;
-    // Status for receiving messages
-    MPI_Status status;
-
-    // Lambda function to remove an element from a deque
-    auto removeElement = [&](std::deque<uint8_t> &deque, uint8_t &sentItemsCounter)
-    {
-        auto it = std::find(deque.begin(), deque.end(), sendNum);
-        if (it != deque.end())
-        {
-            deque.erase(it); // Erase by iterator
-            sentItemsCounter++;
-        }
-    };
+    // The last process writes the sorted numbers directly to the output
+    const bool isLast = procID == noProc - 1;
 
     // Main loop
-    do
+    while (true)
     {
         // Receive a number from the previous process
-        if (shouldIReceive)
+        if (!upstreamDone)
         {
-            uint8_t recNum;
-            MPI_Recv(&recNum, 1, MPI_UNSIGNED_CHAR, (procID - 1), MPI_ANY_TAG, MPI_COMM_WORLD, &status);
-            if (status.MPI_TAG == MSG_FINAL)
+            T num;
+            if (!receiver.receive(num))
             {
-                shouldIReceive = false;
+                upstreamDone = true;
             }
             else
             {
-                num = recNum;
-
                 // Check if the number belongs to the top or bottom queue
-                if (cntRecv == condNeededItemsInTQ)
+                if (cntRecv == runLength)
                 {
                     cntRecv = 0;
                     recvQueue = (recvQueue == Q_TOP) ? Q_BOTTOM : Q_TOP;
@@ -184,104 +2339,389 @@ void processOthers(int procID, int noProc)
 
                 recvQueue == Q_TOP ? qTop.push_back(num) : qBottom.push_back(num);
                 cntRecv++;
+                TRACE_COUNT(elementsReceived, 1);
+                TRACE_MAX(maxTop, qTop.size());
+                TRACE_MAX(maxBottom, qBottom.size());
             }
         }
 
-        // Check if we should initialize a new batch    
-        if (newBatch)
-        {
-            initCond = (qTop.size() >= condNeededItemsInTQ && qBottom.size() >= MIN_ITEMS_IN_BOTTOM_QUEUE);
-            initCond |= status.MPI_TAG;
-        }
-
-        // Process the numbers
-        if (initCond)
+        // Send every number that is already decided
+        while (true)
         {
-            newBatch = false;
+            // A queue is done with the batch when its whole run was sent or when no more numbers will come
+            bool doneT = takenT == runLength || (upstreamDone && qTop.empty());
+            bool doneB = takenB == runLength || (upstreamDone && qBottom.empty());
 
-            // Sort the queues (in batch)
-            if (!qTop.empty() || !qBottom.empty())
+            if (doneT && doneB)
             {
-                std::vector<std::pair<uint8_t, char>> elements; // Pair: value and origin ('T' or 'B')
-               
-                // Get numbers from the queues (only the numbers in current batch) and store them in a vector with their origin
-                int numElementsTop = qTop.size() >= condNeededItemsInTQ - sentItemsT ? condNeededItemsInTQ - sentItemsT : qTop.size();  
-                for (int i = 0; i < numElementsTop; i++)
-                {
-                    elements.emplace_back(qTop[i], 'T');
-                }
-
-                int numElementsBottom = qBottom.size() >= condNeededItemsInTQ - sentItemsB ? condNeededItemsInTQ - sentItemsB : qBottom.size();  
-                for (int i = 0; i < numElementsBottom; i++)
+                if (takenT == 0 && takenB == 0)
                 {
-                    elements.emplace_back(qBottom[i], 'B');
+                    break;
                 }
 
-                // Find the largest element and its origin
-                auto maxElement = std::max_element(elements.begin(), elements.end(),
-                                                   [](const std::pair<uint8_t, char> &a, const std::pair<uint8_t, char> &b)
-                                                   {
-                                                       return a.first < b.first;
-                                                   });
+                // Start a new batch
+                takenT = 0;
+                takenB = 0;
+                TRACE_COUNT(batches, 1);
+                continue;
+            }
 
-                // Send the largest element to the next process
-                if (maxElement != elements.end())
-                {
-                    sendNum = maxElement->first;
+            bool headT = !doneT && !qTop.empty();
+            bool headB = !doneB && !qBottom.empty();
 
-                    // Remove the element from the correct deque
-                    maxElement->second == 'T' ? removeElement(qTop, sentItemsT) : removeElement(qBottom, sentItemsB);
-                }
+            // The merged run is ascending, ties are taken from the top queue first
+            T sendNum;
+            if (headT && (doneB || (headB && !PmsTraits<T>::less(qBottom.front(), qTop.front()))))
+            {
+                sendNum = qTop.front();
+                qTop.pop_front();
+                takenT++;
+            }
+            else if (headB && (doneT || headT))
+            {
+                sendNum = qBottom.front();
+                qBottom.pop_front();
+                takenB++;
+            }
+            else
+            {
+                // Waiting for the next number of the current batch
+                break;
             }
 
-            // Send the number to the next process
-            if (procID < noProc - 1)
+            // Send the number to the next process, the last process writes it to the output
+            TRACE_COUNT(elementsSent, 1);
+            if (!isLast)
             {
-                if (qTop.empty() && qBottom.empty())
-                {
-                    MPI_Send(&sendNum, 1, MPI_UNSIGNED_CHAR, procID + 1, MSG_TAG, MPI_COMM_WORLD);
-                    MPI_Send(&sendNum, 1, MPI_UNSIGNED_CHAR, procID + 1, MSG_FINAL, MPI_COMM_WORLD);
-                    break;
-                }
-                else
-                {
-                    MPI_Send(&sendNum, 1, MPI_UNSIGNED_CHAR, procID + 1, MSG_TAG, MPI_COMM_WORLD);
-                }
+                sender.send(sendNum);
+            }
+            else
+            {
+                writer->write(sendNum);
+            }
+        }
+
+        if (upstreamDone && qTop.empty() && qBottom.empty())
+        {
+            break;
+        }
+    }
+
+    if (!isLast)
+    {
+        sender.close();
+    }
+    else
+    {
+        writer->close();
+    }
+}
+
+
+/**
+ * void sampleSort<T>(int procID, int noProc, const PmsOptions &options)
+ * 
+ * @brief Sort the input with the parallel sample sort engine.
+ * 
+ * @param procID The process ID.
+ * @param noProc The number of processes.
+ * @param options Program options.
+ * 
+ * @return void
+ * 
+ * 1. Every process reads its slice of the input file with MPI-IO and sorts it (sortRun).
+ * 2. Every process takes SAMPLES_PER_PROCESS * noProc regular samples, all samples are gathered
+ *    and noProc - 1 splitters are picked from them.
+ * 3. The sorted slices are cut by the splitters and exchanged with MPI_Alltoallv, process i
+ *    gets all numbers between the splitters i - 1 and i.
+ * 4. The received sorted parts are merged and written in the process order.
+ * 
+ * The local sort and all merges are stable and the parts are merged in the process order,
+ * so equal keys keep their input order like in the pipeline.
+ * 
+*/
+template <typename T>
+void sampleSort(int procID, int noProc, const PmsOptions &options)
+{
+    MPI_Datatype type = PmsTraits<T>::mpiType();
+
+    // Read this process's slice of the input
+    MPI_File input;
+    if (MPI_File_open(MPI_COMM_WORLD, options.inputPath.c_str(), MPI_MODE_RDONLY, MPI_INFO_NULL, &input) != MPI_SUCCESS)
+    {
+        if (procID == 0)
+        {
+            std::cerr << "Failed to open file." << std::endl;
+        }
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    MPI_Offset fileSize;
+    MPI_File_get_size(input, &fileSize);
+    uint64_t total = fileSize / sizeof(T);
+    uint64_t first = total * procID / noProc, last = total * (procID + 1) / noProc;
+
+    std::vector<T> local(last - first), scratch;
+    for (size_t done = 0; done < local.size() * sizeof(T);)
+    {
+        size_t bytes = std::min(MPI_IO_CHUNK, local.size() * sizeof(T) - done);
+        MPI_File_read_at(input, first * sizeof(T) + done, reinterpret_cast<char *>(local.data()) + done,
+                         bytes, MPI_BYTE, MPI_STATUS_IGNORE);
+        done += bytes;
+    }
+    MPI_File_close(&input);
+
+    // The first process prints the unsorted numbers
+    if (procID == 0 && options.echo)
+    {
+        InputReader<T> reader(options.inputPath);
+        T num;
+        while (reader.read(num))
+        {
+            PmsTraits<T>::print(std::cout, num);
+            std::cout << " ";
+        }
+        std::cout << std::endl;
+    }
+
+    sortRun(local, scratch);
+
+    // Regular samples of the sorted slice (none from an empty slice)
+    const int noSamples = local.empty() ? 0 : SAMPLES_PER_PROCESS * noProc;
+    std::vector<T> samples(noSamples);
+    for (int i = 0; i < noSamples; i++)
+    {
+        samples[i] = local[local.size() * i / noSamples];
+    }
+
+    std::vector<int> sampleCounts(noProc), sampleDispls(noProc);
+    MPI_Allgather(&noSamples, 1, MPI_INT, sampleCounts.data(), 1, MPI_INT, MPI_COMM_WORLD);
+    int allSamples = 0;
+    for (int i = 0; i < noProc; i++)
+    {
+        sampleDispls[i] = allSamples;
+        allSamples += sampleCounts[i];
+    }
+    std::vector<T> gathered(allSamples);
+    MPI_Allgatherv(samples.data(), noSamples, type, gathered.data(), sampleCounts.data(), sampleDispls.data(),
+                   type, MPI_COMM_WORLD);
+    sortRun(gathered, scratch);
+
+    // Cut the slice by the splitters, everything up to (and including) splitter i goes to process i
+    std::vector<int> sendCounts(noProc), sendDispls(noProc), recvCounts(noProc), recvDispls(noProc);
+    size_t begin = 0;
+    for (int i = 0; i < noProc; i++)
+    {
+        size_t end = local.size();
+        if (i < noProc - 1 && allSamples > 0)
+        {
+            const T &splitter = gathered[size_t(allSamples) * (i + 1) / noProc];
+            end = std::upper_bound(local.begin() + begin, local.end(), splitter, PmsTraits<T>::less) - local.begin();
+        }
+        if (end - begin > size_t(std::numeric_limits<int>::max()))
+        {
+            std::cerr << "Too many numbers for one process, use more processes." << std::endl;
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        sendCounts[i] = end - begin;
+        sendDispls[i] = begin;
+        begin = end;
+    }
+
+    MPI_Alltoall(sendCounts.data(), 1, MPI_INT, recvCounts.data(), 1, MPI_INT, MPI_COMM_WORLD);
+    size_t received = 0;
+    for (int i = 0; i < noProc; i++)
+    {
+        recvDispls[i] = received;
+        received += recvCounts[i];
+    }
 
+    std::vector<T> mine(received);
+    MPI_Alltoallv(local.data(), sendCounts.data(), sendDispls.data(), type,
+                  mine.data(), recvCounts.data(), recvDispls.data(), type, MPI_COMM_WORLD);
+    local.clear();
+    local.shrink_to_fit();
+
+    // Merge the received parts pairwise, the earlier part always comes first
+    std::vector<size_t> bounds(recvDispls.begin(), recvDispls.end());
+    bounds.push_back(received);
+    scratch.resize(received);
+    while (bounds.size() > 2)
+    {
+        std::vector<size_t> merged;
+        for (size_t i = 0; i + 1 < bounds.size(); i += 2)
+        {
+            merged.push_back(bounds[i]);
+            if (i + 2 < bounds.size())
+            {
+                std::merge(mine.begin() + bounds[i], mine.begin() + bounds[i + 1],
+                           mine.begin() + bounds[i + 1], mine.begin() + bounds[i + 2],
+                           scratch.begin() + bounds[i], PmsTraits<T>::less);
             }
-            // If this is the last process, store the number in the final numbers vector
             else
             {
-                if (!status.MPI_TAG || !qTop.empty() || !qBottom.empty())
-                {
-                    finalNumbers.push_back(sendNum);
-                }
-                else
-                {
-                    finalNumbers.push_back(sendNum);
-                    break;
-                }
+                std::copy(mine.begin() + bounds[i], mine.begin() + bounds[i + 1], scratch.begin() + bounds[i]);
+            }
+        }
+        merged.push_back(received);
+        mine.swap(scratch);
+        bounds.swap(merged);
+    }
+
+    writeSampleSortOutput(procID, noProc, options, mine);
+}
+
+
+/**
+ * void writeSampleSortOutput<T>(int procID, int noProc, const PmsOptions &options, const std::vector<T> &sorted)
+ * 
+ * @brief Write the sorted numbers of all processes in the process order.
+ * 
+ * @param procID The process ID.
+ * @param noProc The number of processes.
+ * @param options Program options.
+ * @param sorted The sorted numbers of this process.
+ * 
+ * @return void
+ * 
+ * The standard output is written by the first process, the others stream their numbers to it one after another.
+ * Files are written in parallel with MPI-IO, every process writes its part at the offset given by the parts
+ * of the processes before it. The result is the same as the output of the pipeline.
+ * 
+*/
+template <typename T>
+void writeSampleSortOutput(int procID, int noProc, const PmsOptions &options, const std::vector<T> &sorted)
+{
+    const int chunkSize = options.chunkSize > 0 ? options.chunkSize : SAMPLE_OUTPUT_CHUNK;
+
+    if (options.outputPath == "-")
+    {
+        if (procID != 0)
+        {
+            // Wait until the first process asks for the numbers, so it receives one stream at a time
+            MPI_Recv(nullptr, 0, MPI_BYTE, 0, MSG_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+            StreamSender<T> sender(0, chunkSize, options.window);
+            for (const T &num : sorted)
+            {
+                sender.send(num);
             }
+            sender.close();
+            return;
+        }
 
-            // Check if we should initialize a new batch
-            if (sentItemsT == condNeededItemsInTQ && sentItemsB == condNeededItemsInTQ)
+        OutputWriter<T> writer(options.outputPath, options.outputFormat);
+        for (const T &num : sorted)
+        {
+            writer.write(num);
+        }
+        for (int source = 1; source < noProc; source++)
+        {
+            MPI_Send(nullptr, 0, MPI_BYTE, source, MSG_TAG, MPI_COMM_WORLD);
+            StreamReceiver<T> receiver(source, chunkSize, options.window);
+            T num;
+            while (receiver.receive(num))
             {
-                sentItemsT = 0;
-                sentItemsB = 0;
-                initCond = false;
-                newBatch = true;
+                writer.write(num);
             }
         }
-    } while (qTop.size() > 0 || qBottom.size() > 0);
+        writer.close();
+        return;
+    }
+
+    // Format the part of this process
+    std::vector<char> data;
+    if (options.outputFormat == OUT_BINARY)
+    {
+        data.resize(sorted.size() * sizeof(T));
+        std::memcpy(data.data(), sorted.data(), data.size());
+    }
+    else
+    {
+        char text[FORMAT_BUFFER_SIZE];
+        for (const T &num : sorted)
+        {
+            char *end = PmsTraits<T>::format(text, text + sizeof(text), num);
+            *end++ = '\n';
+            data.insert(data.end(), text, end);
+        }
+        // The text output ends with an empty line
+        if (procID == noProc - 1)
+        {
+            data.push_back('\n');
+        }
+    }
+
+    uint64_t size = data.size(), offset = 0, total = 0;
+    MPI_Exscan(&size, &offset, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+    MPI_Allreduce(&size, &total, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+    if (procID == 0)
+    {
+        offset = 0;
+    }
+
+    MPI_File output;
+    if (MPI_File_open(MPI_COMM_WORLD, options.outputPath.c_str(), MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL,
+                      &output) != MPI_SUCCESS)
+    {
+        if (procID == 0)
+        {
+            std::cerr << "Failed to open output file." << std::endl;
+        }
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    MPI_File_set_size(output, total);
+
+    for (size_t done = 0; done < data.size();)
+    {
+        size_t bytes = std::min(MPI_IO_CHUNK, data.size() - done);
+        MPI_File_write_at(output, offset + done, data.data() + done, bytes, MPI_BYTE, MPI_STATUS_IGNORE);
+        done += bytes;
+    }
+    MPI_File_close(&output);
+}
+
+
+/**
+ * void serialSort<T>(const PmsOptions &options)
+ * 
+ * @brief Sort the whole input in this process with std::stable_sort.
+ * 
+ * @param options Program options.
+ * 
+ * @return void
+ * 
+ * Reference for the benchmarks: the same input and output code as the other engines
+ * around a plain library sort. The sort is stable, so the output is the same as the
+ * output of the pipeline also for records with equal keys.
+ * 
+*/
+template <typename T>
+void serialSort(const PmsOptions &options)
+{
+    std::vector<T> numbers;
+    InputReader<T> reader(options.inputPath);
+    T num;
+    while (reader.read(num))
+    {
+        numbers.push_back(num);
+    }
 
-    // Print the final numbers
-    if (procID == noProc - 1)
+    if (options.echo)
     {
-        while (!finalNumbers.empty())
+        for (const T &value : numbers)
         {
-            std::cout << static_cast<unsigned int>(finalNumbers.back()) << "\n";
-            finalNumbers.pop_back();
+            PmsTraits<T>::print(std::cout, value);
+            std::cout << " ";
         }
         std::cout << std::endl;
     }
-}
\ No newline at end of file
+
+    std::stable_sort(numbers.begin(), numbers.end(), PmsTraits<T>::less);
+
+    OutputWriter<T> writer(options.outputPath, options.outputFormat);
+    for (const T &value : numbers)
+    {
+        writer.write(value);
+    }
+    writer.close();
+}
@@ -17,8 +17,8 @@ mpic++ --prefix /usr/local/share/OpenMPI -o pms pms.cpp
 #vyrobeni souboru s nahodnymi cisly
 dd if=/dev/random bs=1 count=$numbers of=numbers 2> /dev/null	 
 
-#spusteni programu
-mpirun --use-hwthread-cpus  --prefix /usr/local/share/OpenMPI  -np $proc pms 				
+#spusteni programu (dalsi argumenty skriptu se predaji programu, napr. -b 4096)
+mpirun --use-hwthread-cpus  --prefix /usr/local/share/OpenMPI  -np $proc pms "${@:2}"				
 
 #uklid
 rm -f pms numbers
\ No newline at end of file
@@ -8,28 +8,104 @@
  * @note This program implements Conway's Game of Life, a cellular automaton, using the Message Passing Interface (MPI) for parallelization.
  * It reads an input file containing the initial state of the grid, runs the simulation for a specified number of time steps,
  * and prints the final state of the grid. The simulation is parallelized across multiple MPI processes.
- * The program is limited bu the number of CPUs. The number of CPUs must be equal to the number of rows in the input file.
+ * The grid (a torus) is split into 2D tiles of rows and columns by a Cartesian communicator (MPI_Cart_create),
+ * so any number of processes can be used. If there are more processes than tiles that fit into the grid,
+ * the extra processes stay idle.
  * 
  * @note To compile the program, use a C++ compiler with MPI support. For example:
  *      mpic++ --prefix /usr/local/share/OpenMPI --std=c++17 -o life life.cpp
  * 
+ * @note The engine can also be built into another program (life_harness.cpp): define LIFE_NO_MAIN before
+ * including this file. MPI is then initialized by that program, GameOfLife only uses it.
+ * 
  * @note To run the program, use the mpirun command with the desired number of MPI processes:
- *      mpirun --oversubscribe --prefix /usr/local/share/OpenMPI -np <rows_count> life <input_file> <num_of_steps>
+ *      mpirun --oversubscribe --prefix /usr/local/share/OpenMPI -np <processes> life <input_file> <num_of_steps>
  * 
  * @note Or run the program using the provided test.sh script:
- *      ./test.sh <input_file> <num_of_steps>
+ *      ./test.sh <input_file> <num_of_steps> [processes]
+ * 
+ * @note Options (after the two arguments):
+ *      -k kernel       Kernel of the simulation. auto (default), scalar, avx2 and avx512 keep one byte
+ *                      per cell in a flat padded grid and compute whole vectors of cells: the vertical
+ *                      sums of three cells are computed once per row and reused for the three
+ *                      horizontal positions, the rule is applied without branches. auto picks the
+ *                      widest kernel the CPU supports (runtime dispatch, scalar on non-x86 machines).
+ *                      bits packs 64 cells into every uint64_t word and computes a whole word per
+ *                      step with bit-sliced adders (SWAR), the halos are exchanged in packed form too.
+ *      -g width|auto   Ghost width of the byte kernels (default 1). Every tile keeps `width` ghost
+ *                      rows and columns, the halos are exchanged once every `width` generations and
+ *                      the generations in between compute the shrinking valid part of the ghost zone
+ *                      again locally. auto measures the exchange and the compute time and picks the
+ *                      width with the lowest modelled time per generation.
+ *      -t threads      Threads per process (default 1). The tile is split into bands of rows, one per
+ *                      thread, and every thread zeroes its own band first, so the pages of the band
+ *                      are placed on its NUMA node (first touch). The threads are pinned to the CPUs
+ *                      the process may run on (e.g. one process per socket with mpirun --bind-to socket)
+ *                      if there are enough of them. Only the main thread calls MPI, the halos of the
+ *                      whole tile are exchanged once per process.
+ *      -a              Active blocks (byte kernels with ghost width 1). The tile is split into blocks of
+ *                      BLOCK_SIZE x BLOCK_SIZE cells and a block is computed only if a cell of it or
+ *                      a cell next to it (in a neighbour block or the ghost zone) changed in the last
+ *                      generation. An unchanged halo is sent as an empty message and the receiver keeps
+ *                      its ghost cells, so the time of sparse or settled patterns follows the activity
+ *                      instead of the area of the grid.
+ *      -e engine       grid (default) simulates the tiles one generation at a time with the options
+ *                      above. hashlife runs HashLife on the first process: the time grows with the
+ *                      number of distinct blocks of the pattern and the logarithm of the game time
+ *                      (up to 2^60 generations), not with the game time. The options above are ignored.
+ *      -o file         Write the final grid into the file (text, RLE or binary by the extension, like the input,
+ *                      the text has no row numbers) with MPI-IO instead of printing it.
+ *      -c nodes        Bound of the HashLife node cache (default 4194304 nodes), checked before every result
+ *                      is computed. Above it, the nodes that are neither part of the current grid, nor in the
+ *                      results being computed, nor the memoized results of those nodes are collected. If these
+ *                      nodes alone exceed the bound, the cache grows by at most half of them (or of the bound) more.
+ *                      The statistics of the nodes (with the peak) are printed to the standard error output.
+ *      -s generations  Write a checkpoint (the grid, the generation and the rule) every `generations` generations
+ *                      (grid engine). The tile is copied and written with non-blocking collective MPI-IO
+ *                      while the next generations are computed, the write is completed at the next
+ *                      checkpoint or at the end of the run. The file has two slots used in turns, a slot
+ *                      is marked complete only after its cells are on the disk, so a killed run always
+ *                      leaves one complete checkpoint (after the first one).
+ *      -f file         Checkpoint file (default life.ckpt).
+ *      -r              Restart from the latest complete checkpoint of the checkpoint file (if there is
+ *                      one, otherwise start from the input file) and run up to the game time. The
+ *                      checkpoint may be read by any number of processes.
+ *      -q              Do not print (or write) the final grid, for measurements.
+ *      -n processes    Use at most `processes` processes for the tiles, the others stay idle (scaling
+ *                      measurements within one MPI job).
+ *      -d layout       tiles (default) splits the grid into 2D tiles, rows into bands of whole rows.
+ *      -p period       Detect cycles of up to `period` samples (grid engine). The grid is sampled after
+ *                      every generation (every `width` generations with -g): every thread hashes its band,
+ *                      the hashes of the processes are summed with MPI_Allreduce and compared with the
+ *                      last `period` samples. A repeated hash is verified by comparing the tile with the
+ *                      tile one period later (so a hash collision is never taken for a cycle), then the
+ *                      run skips the whole periods left and computes only the rest of the game time.
+ *      -b rule         Life-like rule (default B3/S23, or the rule of an RLE input), B<counts>/S<counts> or
+ *                      <survival counts>/<birth counts>: a dead cell with a birth count of live neighbours
+ *                      becomes alive, a live cell with a survival count stays alive. B3/S23, HighLife (B36/S23),
+ *                      Day & Night (B3678/S34678) and Seeds (B2/S) have kernels specialized at compile time
+ *                      (comparisons or a constant table of the byte kernels, folded logic of the bits kernel),
+ *                      the other rules use kernels that read the rule table or masks. A restart (-r) from a
+ *                      checkpoint continues with the rule of the checkpoint (-b must be the same if given).
  * 
  * @note This program requires a text file containing the initial state of the grid and the number of time steps for the simulation.
  * The input file should contain rows of 0s and 1s, where 0 represents a dead cell and 1 represents a live cell.
+ * Files ending with .rle are read as patterns in the RLE format (x = columns, y = rows, optional rule), files ending
+ * with .bin in the binary format: the magic "LIFEBITS", the number of rows and columns (32-bit, byte order of the machine) and
+ * the rows of cells, 8 cells per byte (the first cell in the lowest bit), every row starts at a new byte.
+ * All processes read the file together with MPI-IO, every process reads only its tile (the RLE body is split
+ * into equal chunks, the live runs are sent to the tiles they belong to).
  * 
  * @note The program uses the following rules to determine the next state of each cell in the grid:
  * - Any live cell with fewer than two live neighbours dies (underpopulation).
  * - Any live cell with two or three live neighbours lives on to the next generation.
  * - Any live cell with more than three live neighbours dies (overpopulation).
  * - Any dead cell with exactly three live neighbours becomes a live cell (reproduction).
+ * This is the rule B3/S23, other Life-like rules are given by -b.
  * 
  * @note The program prints the final state of the grid to the standard output, where each row represents a row in the grid.
  * The final state of the grid is printed in the same format as the input file, with 0s and 1s representing dead and live cells, respectively.
+ * Every row is prefixed by its index ("<row>: ").
  * 
  * @note The program was tested using generated test cases for 4x4 to 12x12 grids with various initial configurations with different numbers of time steps.
  * 
@@ -39,14 +115,277 @@
 
 
 #include <iostream>
-#include <fstream>
 #include <string>
+#include <cstring>
+#include <cctype>
 #include <vector>
+#include <algorithm>
+#include <iterator>
+#include <array>
+#include <unordered_map>
+#include <deque>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
 #include <mpi.h>
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_KERNELS    1
+#endif
+
 #define ALIVE_CELL  1
 #define DEAD_CELL   0
-#define N_ROWS_LOCAL_W_GHOST    3   // Number of rows for each process with ghost rows
+#define N_DIMS      2   // Dimensions of the process grid
+#define LIFE_OPTIONS    "k:g:t:ae:o:c:s:f:rqn:d:p:b:"   // Options of getopt (after the file and the game time)
+
+// Message tags
+#define TAG_TILE    0   // Tile of the final grid (printed by the first process)
+#define TAG_WEST    1   // Halo travelling west (the east column of the sender)
+#define TAG_EAST    2   // Halo travelling east (the west column of the sender)
+#define TAG_NORTH   3   // Halo travelling north (the first row of the sender)
+#define TAG_SOUTH   4   // Halo travelling south (the last row of the sender)
+#define TAG_NORTH_WEST  5   // Corner travelling north-west (the first cell of the sender)
+#define TAG_NORTH_EAST  6   // Corner travelling north-east
+#define TAG_SOUTH_WEST  7   // Corner travelling south-west
+#define TAG_SOUTH_EAST  8   // Corner travelling south-east (the last cell of the sender)
+
+#define N_HALOS     8   // Halo messages of a tile in each direction (4 edges and 4 corners)
+
+#define MAX_GHOST_WIDTH 64  // Widest ghost zone considered by the automatic tuning
+#define TUNE_ROUNDS     10  // Measured exchanges and generations of the automatic tuning
+
+#define WORD_BITS   64  // Cells in one word of the packed grid
+
+#define BLOCK_SIZE  64  // Rows and columns of the blocks of the active-block tracking (-a)
+
+#define HASHLIFE_MAX_NODES  (1 << 22)   // Default bound of the HashLife node cache (-c)
+#define HASHLIFE_MAX_POWER  60          // Game times of HashLife are below 2^(HASHLIFE_MAX_POWER + 1)
+#define NO_NODE     UINT32_MAX          // Missing HashLife node (a result that is not computed yet)
+
+#define HEADER_CHUNK        4096    // Bytes read at a time while looking for the header of the input file
+#define RLE_LOOKAHEAD       64      // Bytes read after the RLE chunk of a process (the rest of its last token)
+#define RLE_LINE_LENGTH     70      // Longest line of the written RLE files
+#define BINARY_MAGIC        "LIFEBITS"
+#define BINARY_HEADER_SIZE  16      // Magic, rows and columns of the binary format
+#define CHECKPOINT_MAGIC    "LIFECKP2"
+#define CHECKPOINT_SLOTS    2       // Slots of the checkpoint file, written in turns
+#define CHECKPOINT_RULE     (16 + 8 * CHECKPOINT_SLOTS)    // Offset of the birth and survival masks in the checkpoint header
+#define CHECKPOINT_HEADER_SIZE  (CHECKPOINT_RULE + 4)   // Magic, rows, columns, the generation of every slot and the rule
+
+#define HASH_MULTIPLIER     0x9e3779b97f4a7c15ULL   // Odd constants of the hashes of the grid
+#define HASH_POSITION       0xd6e8feb86659fd93ULL
+#define HASH_KEY            0x85ebca6bU             // Keys of the words of a row
+#define HASH_KEY_FLIP       0x5bd1e995U
+
+#define SPIN_COUNT  64  // Unsuccessful polls of a barrier before the thread yields
+
+#define GRID_ALIGNMENT  64  // Alignment of the rows of the byte grid (a cache line)
+#define MAX_VECTOR      64  // Width of the widest vector of the byte kernels (AVX-512)
+
+#define RULE_COUNTS     9   // Neighbour counts of a cell (0 to 8), the bits of the masks of a rule
+#define RULE_MAX_SUM    9   // Largest 3x3 sum of a cell (its neighbours and itself)
+#define RULE_TABLE      16  // Entries of the rule table of one state of a cell (by its 3x3 sum)
+#define RULE_COMPARES   2   // Comparisons of the 3x3 sum the byte kernels use at most instead of the table
+#define RULE_RUNTIME_MASK   UINT16_MAX  // Masks of the kernels that read the rule table (template arguments)
+#define RULE_RUNTIME    RULE_RUNTIME_MASK, RULE_RUNTIME_MASK
+
+// Rules with kernels specialized at compile time (birth and survival masks)
+#define RULE_LIFE           0x008, 0x00c    // B3/S23, Conway's Game of Life
+#define RULE_HIGHLIFE       0x048, 0x00c    // B36/S23
+#define RULE_DAY_AND_NIGHT  0x1c8, 0x1d8    // B3678/S34678
+#define RULE_SEEDS          0x004, 0x000    // B2/S
+
+// Kernels of the simulation
+enum Kernel
+{
+    KERNEL_AUTO,    // The widest byte kernel the CPU supports
+    KERNEL_SCALAR,  // One byte per cell, plain loops
+    KERNEL_AVX2,    // One byte per cell, 32 cells per step
+    KERNEL_AVX512,  // One byte per cell, 64 cells per step
+    KERNEL_BITS     // 64 cells per uint64_t word, bit-sliced (SWAR) rule
+};
+
+// Layouts of the tiles
+enum Layout
+{
+    LAYOUT_TILES,   // 2D tiles (as square as possible)
+    LAYOUT_ROWS     // Bands of whole rows
+};
+
+// Engines of the simulation
+enum Engine
+{
+    ENGINE_GRID,    // Tiles of the grid on all processes, one generation at a time
+    ENGINE_HASHLIFE // Hash-consed quadtree with memoized results on the first process
+};
+
+// Formats of the grid files (by the extension)
+enum GridFormat
+{
+    FORMAT_TEXT,    // Rows of 0 and 1
+    FORMAT_RLE,     // Run length encoded pattern (.rle)
+    FORMAT_BINARY,  // Header and rows of bit-packed cells (.bin)
+    FORMAT_CHECKPOINT   // Slot of a checkpoint file (a byte per cell)
+};
+
+// Errors in the tiles of the input file, found by any process
+enum InputError
+{
+    INPUT_OK,
+    INPUT_LINE_LENGTH,
+    INPUT_CHARACTER,
+    INPUT_RLE_TAG,
+    INPUT_RLE_SIZE
+};
+
+// Changes of a block in a generation: its cells, and the cells at its edges and corners (in the
+// order of the halos, the changes a halo of the tile or a neighbour block depends on)
+enum BlockChange
+{
+    CHANGE_CELLS = 1,
+    CHANGE_NORTH = 1 << 1,
+    CHANGE_SOUTH = 1 << 2,
+    CHANGE_WEST = 1 << 3,
+    CHANGE_EAST = 1 << 4,
+    CHANGE_NORTH_WEST = 1 << 5,
+    CHANGE_NORTH_EAST = 1 << 6,
+    CHANGE_SOUTH_WEST = 1 << 7,
+    CHANGE_SOUTH_EAST = 1 << 8
+};
+
+// Life-like rule: bit n of birth (survival) is set if a dead (live) cell with n live neighbours
+// is alive in the next generation
+struct Rule
+{
+    uint16_t birth = 1 << 3;
+    uint16_t survival = 1 << 2 | 1 << 3;
+
+    bool operator==(const Rule &other) const { return birth == other.birth && survival == other.survival; }
+};
+
+// Next state of a dead cell by its 3x3 sum, then of a live cell by its 3x3 sum (the byte kernels)
+typedef std::array<uint8_t, 2 * RULE_TABLE> RuleTable;
+
+// Computes cells 1..cols of one row of the next generation from the rows above, at and below
+// (sums is a scratch row of the same size as the grid rows, table is read by the kernels of the runtime rule)
+typedef void (*RowKernel)(const uint8_t *above, const uint8_t *row, const uint8_t *below,
+                          uint8_t *next, uint8_t *sums, int cols, const uint8_t *table);
+
+/**
+ * Barrier of the threads of one process.
+ *
+ * @brief The threads spin on the phase of the barrier (yielding the CPU after SPIN_COUNT polls),
+ *  the last thread to arrive runs the completion step before it releases the others.
+ */
+class ThreadBarrier {
+public:
+    explicit ThreadBarrier(int count) : count(count) {}
+
+    template <typename Completion>
+    void wait(Completion completion)
+    {
+        unsigned current = phase.load(std::memory_order_acquire);
+        if (arrived.fetch_add(1, std::memory_order_acq_rel) + 1 == count)
+        {
+            completion();
+            arrived.store(0, std::memory_order_relaxed);
+            phase.store(current + 1, std::memory_order_release);
+            return;
+        }
+        for (int polls = 0; phase.load(std::memory_order_acquire) == current; polls++)
+        {
+            if (polls >= SPIN_COUNT)
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    void wait()
+    {
+        wait([] {});
+    }
+
+private:
+    const int count;
+    std::atomic<int> arrived{0};
+    std::atomic<unsigned> phase{0};
+};
+
+
+/**
+ * HashLife engine (-e hashlife).
+ *
+ * @brief The grid is a torus, so it is simulated as the infinite plane covered by copies of it.
+ *  Blocks of 2^k x 2^k cells of the plane are the nodes of a quadtree, equal blocks are one node
+ *  (hash consing), and the result of a node (its center 2^(k-1) x 2^(k-1) cells after 2^(k-2)
+ *  generations) is computed once from the results of its sub-blocks and kept in the node.
+ *  The grid is advanced by the powers of two of the game time, each one by the results of the
+ *  blocks around the windows that cover the grid. A block of the plane only depends on its position
+ *  modulo the size of the grid, so even the huge blocks of the long steps are few distinct nodes.
+ */
+class HashLife {
+public:
+    HashLife(int rows, int cols, size_t maxNodes, const Rule &rule);
+
+    void run(std::vector<uint8_t> &cells, long long generations);
+    void printStatistics(std::ostream &out) const;
+
+private:
+    // Node of the quadtree: 2^level x 2^level cells (the nodes 0 and 1 of level 0 are a dead and a live
+    // cell), children in the order north-west, north-east, south-west, south-east, memoized result
+    struct Node
+    {
+        uint32_t child[4];
+        uint32_t result;
+        uint8_t level;
+        bool marked;
+    };
+
+    struct ChildrenHash
+    {
+        size_t operator()(const std::array<uint32_t, 4> &children) const;
+    };
+
+    int rows, cols;
+    size_t maxNodes, collectAt;
+    Rule rule;
+    std::vector<Node> nodes;
+    std::vector<uint32_t> freeNodes;
+    std::unordered_map<std::array<uint32_t, 4>, uint32_t, ChildrenHash> nodeTable;
+    // Blocks of the plane of the current grid by level and position (for one power of two)
+    std::unordered_map<uint64_t, uint32_t> blocks;
+    // Nodes held by the results being computed (kept by the collections)
+    std::vector<uint32_t> pinned;
+    const std::vector<uint8_t> *grid = nullptr;
+
+    size_t peakNodes = 0, collections = 0, resultsComputed = 0, resultsReused = 0;
+
+    uint32_t join(uint32_t nw, uint32_t ne, uint32_t sw, uint32_t se);
+    uint32_t block(int level, long long row, long long col);
+    uint32_t result(uint32_t node);
+    uint32_t baseResult(uint32_t node);
+    void extract(uint32_t node, long long row, long long col, std::vector<uint8_t> &cells) const;
+    void advance(std::vector<uint8_t> &cells, int power);
+    void collect();
+    size_t liveNodes() const;
+};
+
+
+// Measurements of a run (of one process)
+struct RunStatistics
+{
+    long long generations = 0;  // Generations computed (without the skipped periods)
+    double seconds = 0;         // Time of the generations
+    double haloSeconds = 0;     // Time of the main thread in the halo exchanges (not hidden by the interior)
+};
+
 
 class GameOfLife {
 public:
@@ -55,308 +394,3755 @@ public:
 
     void runSimulation();
     void readInputFile(const std::string& filename);
+    void generateGrid(int rows, int cols, double density, uint64_t seed);
+    const RunStatistics &statistics() const { return runStatistics; }
 
 private:
     int rank, noRanks;
-    int line_length;
-    int gameTime;
-    std::vector<int> current_line_in_ints;
-    std::vector<std::vector<int>> currGrid;
-    std::vector<std::vector<int>> nextGrid;
+    int threadLevel = MPI_THREAD_SINGLE;
+    // MPI was initialized by this object (not by a program the engine is built into)
+    bool ownsMPI = false;
+    long long gameTime;
+    // Print (or write) the final grid, processes used for the tiles at most (0 for all), layout of the tiles
+    bool printResult = true;
+    int maxRanks = 0;
+    Layout layout = LAYOUT_TILES;
+    RunStatistics runStatistics;
+    Engine engine = ENGINE_GRID;
+    // HashLife (on the first process): bound of the node cache and the whole grid
+    size_t cacheNodes = HASHLIFE_MAX_NODES;
+    std::vector<uint8_t> wholeGrid;
+    // File the final grid is written to (printed if empty)
+    std::string outputPath;
+    // Checkpoints: generations between them (0 for none), the file, restart from it, generation the run starts at
+    long long checkpointInterval = 0;
+    std::string checkpointPath = "life.ckpt";
+    bool restart = false;
+    long long startTime = 0;
+    // Checkpoint being written: the file, the request, the copy of the tile, its slot and generation (-1 for none)
+    MPI_File checkpointFile = MPI_FILE_NULL;
+    MPI_Request checkpointRequest = MPI_REQUEST_NULL;
+    std::vector<uint8_t> checkpointTile;
+    int checkpointSlot = 0;
+    long long checkpointTime = -1;
+    // Cycle detection: samples kept (0 for none), the hashes of the bands, the last global hashes with their
+    // generations, the cycle being verified (its start, period and the tile at its start) and the generation
+    // the threads continue at (after skipped periods)
+    int cyclePeriods = 0;
+    std::vector<uint64_t> threadHashes;
+    std::deque<std::pair<uint64_t, long long>> cycleHistory;
+    long long verifyTime = -1, verifyPeriod = 0;
+    std::vector<uint8_t> verifyTile;
+    long long resumeTime = 0;
+    Kernel kernel = KERNEL_AUTO;
+    RowKernel rowKernel = nullptr;
+    // Rule of the automaton (given by -b, else taken from an RLE input), its table and the bits kernel of the rule
+    Rule rule;
+    bool ruleGiven = false;
+    RuleTable ruleTable{};
+    void (GameOfLife::*bitsKernel)(int) = nullptr;
+
+    // Size of the whole grid
+    int globalRows = 0, globalCols = 0;
+
+    // Cartesian communicator of the active processes (MPI_COMM_NULL on the idle ones)
+    MPI_Comm cartComm = MPI_COMM_NULL;
+    int dims[N_DIMS] = {0, 0};
+    int coords[N_DIMS] = {0, 0};
+    int north, south, west, east;
+    int northWest, northEast, southWest, southEast;
+
+    // The tile of this process: position in the grid and size without the ghost cells
+    int firstRow = 0, firstCol = 0;
+    int localRows = 0, localCols = 0;
+
+    // Tiles with ghostWidth ghost rows/columns on every side: localRows + 2 * ghostWidth rows of `stride`
+    // bytes, the cell (i, j) of the tile is at (i + ghostWidth) * stride + j + ghostWidth. The rows are
+    // padded for the widest vector and aligned to a cache line
+    int ghostWidth = 1;
+    bool tuneGhosts = false;
+    size_t stride = 0;
+    std::unique_ptr<uint8_t[]> gridBuffers[2];
+    uint8_t *currGrid = nullptr, *nextGrid = nullptr;
+    // Vertical sums of the row being computed, one scratch row per thread
+    std::vector<std::vector<uint8_t>> rowSums;
+    // Halo strips: ghostWidth rows of the tile, ghostWidth columns, and a corner block
+    MPI_Datatype rowType = MPI_DATATYPE_NULL, columnType = MPI_DATATYPE_NULL, cornerType = MPI_DATATYPE_NULL;
+    // Persistent halo requests (receives, then sends) for each of the two grids, and the set of currGrid
+    MPI_Request haloRequests[2][2 * N_HALOS];
+    int haloSet = 0;
+    // Received west and east ghost columns (localRows x ghostWidth), copied into the grid once the exchange is complete
+    std::vector<uint8_t> westColumn, eastColumn;
+    // Requests of the running exchange (the sends of unchanged halos are taken from emptyRequests)
+    MPI_Request startedRequests[2 * N_HALOS];
+
+    // Active blocks (-a): changes of the blocks in the last generation (BlockChange flags), blocks to
+    // compute in the next one and blocks next to changed ghost cells (block (i, j) is at i * blockCols + j)
+    bool trackActivity = false;
+    int blockRows = 0, blockCols = 0;
+    std::vector<uint16_t> blockChanged;
+    std::vector<uint8_t> blockActive, ghostActive;
+    // Changes found by every thread, and a scratch row per thread the rows are computed into
+    std::vector<std::vector<uint16_t>> threadChanged;
+    std::vector<std::vector<uint8_t>> nextRows;
+    // Empty sends of unchanged halos for each of the two grids
+    MPI_Request emptyRequests[2][N_HALOS];
+
+    // Packed tiles (bits kernel): bit b of word w of a row is the column WORD_BITS * w + b of the
+    // tile with ghost cells (column 0 is the west ghost column), rows are rowWords words apart
+    int rowWords = 0, columnWords = 0;
+    std::vector<uint64_t> currBits, nextBits;
+    // Columns of the tile that may change (the interior), per word of a row
+    std::vector<uint64_t> interiorMask;
+    // Packed west and east halo columns (one bit per row)
+    std::vector<uint64_t> sendBits, recvBits;
+
+    // Threads of the process: thread 0 is the main thread (the only one calling MPI), the others wait
+    // in the barrier for the work given to runThreads. Thread t computes the rows of its band
+    int noThreads = 1;
+    std::vector<std::thread> workers;
+    std::unique_ptr<ThreadBarrier> threadBarrier;
+    std::function<void(int)> threadWork;
+    bool stopWorkers = false;
 
     void initializeMPI(int argc, char** argv);
-    void communicateBoundaryRows();
-    void calculateNextGrid();
+    void setRule(const Rule &newRule);
+    void assignTile(int &row, int &col, int &rows, int &cols);
+    void placeTile(std::vector<uint8_t> &tile);
+    void readGridHeader(MPI_File file, GridFormat format, MPI_Offset &body, int &lineLength);
+    std::vector<uint8_t> readTile(MPI_File file, GridFormat format, MPI_Offset body, int lineLength,
+                                  int row, int col, int rows, int cols);
+    void readRleTile(MPI_File file, MPI_Offset body, int row, int col, int cols, std::vector<uint8_t> &tile);
+    void reportInputError(int error) const;
+    void transferRect(MPI_File file, MPI_Offset displacement, int rowSize, int row, int first, int rows, int count,
+                      char *data, bool write) const;
+    int tileOwner(int row, int col, int &colEnd) const;
+    std::vector<uint8_t> gatherBand(const std::vector<uint8_t> &tile, int rows, int &bandRow, int &bandRows) const;
+    void writeOutputFile(const std::vector<uint8_t> &tile, int row, int col, int rows, int cols);
+    bool findCheckpoint(MPI_File &file, MPI_Offset &body);
+    void openCheckpoint();
+    void startCheckpoint(long long time);
+    void progressCheckpoint();
+    void finishCheckpoint();
+    void closeCheckpoint();
+    uint64_t hashBand(int thread) const;
+    long long detectCycle(int thread, long long time);
+    void checkCycle(long long time);
+    bool sampledAt(long long time) const;
+    void createDecomposition();
+    void tileExtent(const int tileCoords[N_DIMS], int &row, int &col, int &rows, int &cols) const;
+    void allocateGrids();
+    uint8_t *cellAt(uint8_t *grid, int row, int col) const;
+    std::vector<uint8_t> getTile() const;
+    void setTile(const uint8_t *tile);
+    void tuneGhostWidth();
+    void createHaloRequests();
+    void freeHaloRequests();
+    void startHaloExchange();
+    void finishHaloExchange();
+    void calculateInterior(int thread);
+    void calculateBoundary(int thread);
+    void calculateRegion(int thread, int first, int rowEnd, int colEnd);
+    void calculateRows(int thread, int rowBegin, int rowEnd, int colBegin, int colEnd);
     void swapGrids();
     void printGrid();
+
+    void allocateBlocks();
+    void haloBlocks(int halo, int &rowBegin, int &rowEnd, int &colBegin, int &colEnd) const;
+    bool haloChanged(int halo) const;
+    void receiveGhostChanges(MPI_Status statuses[N_HALOS]);
+    void calculateActiveBlocks(int thread, bool interior);
+    void calculateBlockRows(int thread, int block, int rowBegin, int rowEnd, int colBegin, int colEnd);
+    void updateActivity();
+
+    void runHashLife();
+
+    void packGrid();
+    void unpackGrid();
+    void communicateHaloBits();
+    template <uint16_t Birth, uint16_t Survival>
+    void calculateNextBits(int thread);
+
+    void createThreads();
+    void joinThreads();
+    void threadLoop(int thread);
+    void runThreads(const std::function<void(int)> &work);
+    int bandBegin(int thread) const;
+    int bandEnd(int thread) const;
 };
 
 
 /**
- * Constructor for the GameOfLife class.
+ * Builds the rule table of the byte kernels.
  *
- * @param argc Number of command-line arguments.
- * @param argv Array of command-line arguments.
- * @brief Initializes MPI and retrieves the game time from command-line arguments.
+ * @param birth Birth mask of the rule.
+ * @param survival Survival mask of the rule.
+ * @return The table (a dead cell with the 3x3 sum n has n live neighbours, a live cell n - 1).
  */
-GameOfLife::GameOfLife(int argc, char **argv)
+static constexpr RuleTable buildRuleTable(uint16_t birth, uint16_t survival)
 {
-    initializeMPI(argc, argv);
-
-    if (argc != 3)
+    RuleTable table{};
+    for (int count = 0; count < RULE_COUNTS; count++)
     {
-        fprintf(stderr, "Usage: %s <file.txt> <game time>\n", argv[0]);
-        MPI_Abort(MPI_COMM_WORLD, 1);
+        table[count] = (birth >> count) & 1;
+        table[RULE_TABLE + count + 1] = (survival >> count) & 1;
     }
+    return table;
+}
 
-    // Get time argument from command line
-    gameTime = atoi(argv[2]);
+
+/**
+ * Tests if a 3x3 sum is in a set known at compile time (one comparison per sum of the set).
+ *
+ * @param total The 3x3 sum.
+ * @return 1 if bit `total` of Sums is set, 0 otherwise.
+ */
+template <unsigned Sums, int Sum = 0>
+static inline uint8_t matchScalar(uint8_t total)
+{
+    if constexpr (Sum > RULE_MAX_SUM)
+        return 0;
+    else if constexpr (((Sums >> Sum) & 1) == 0)
+        return matchScalar<Sums, Sum + 1>(total);
+    else
+        return (total == Sum) | matchScalar<Sums, Sum + 1>(total);
 }
 
 
 /**
- * Destructor for the GameOfLife class.
+ * Row kernel without vector instructions.
  *
- * @brief Finalizes MPI.
+ * @brief Sums every column of the three rows once, then every cell adds the three column sums
+ *  around it (the 3x3 sum including the cell). A rule known at compile time (Birth, Survival) with
+ *  at most RULE_COMPARES sums is comparisons of the sum: the sums every cell lives at, and the sums
+ *  only a dead or only a live cell lives at (for B3/S23 the sum is 3, or it is 4 and the cell is
+ *  alive). Any other rule looks the cell up in its table (a constant for a rule known at compile
+ *  time, the rule table for RULE_RUNTIME). The loops have no branches, so the compiler can
+ *  vectorize them too.
  */
-GameOfLife::~GameOfLife()
+template <uint16_t Birth, uint16_t Survival>
+static void rowKernelScalar(const uint8_t *above, const uint8_t *row, const uint8_t *below,
+                            uint8_t *next, uint8_t *sums, int cols, const uint8_t *table)
 {
-    MPI_Finalize();
+    for (int j = 0; j <= cols + 1; j++)
+    {
+        sums[j] = above[j] + row[j] + below[j];
+    }
+
+    constexpr unsigned born = Birth, stays = unsigned(Survival) << 1;
+    constexpr bool compare = Birth != RULE_RUNTIME_MASK && __builtin_popcount(born | stays) <= RULE_COMPARES;
+    static constexpr RuleTable fixedTable = buildRuleTable(Birth, Survival);
+    const uint8_t *rules = Birth == RULE_RUNTIME_MASK ? table : fixedTable.data();
+    for (int j = 1; j <= cols; j++)
+    {
+        uint8_t total = sums[j - 1] + sums[j] + sums[j + 1];
+        if constexpr (!compare)
+            next[j] = rules[row[j] * RULE_TABLE + total];
+        else
+            next[j] = matchScalar<born & stays>(total) | (matchScalar<born & ~stays>(total) & (row[j] ^ 1)) |
+                      (matchScalar<stays & ~born>(total) & row[j]);
+    }
 }
 
 
+#ifdef HAVE_X86_KERNELS
 /**
- * Initializes MPI.
+ * Tests 32 3x3 sums against a set known at compile time (AVX2).
  *
- * @param argc Number of command-line arguments.
- * @param argv Array of command-line arguments.
- * @brief Initializes MPI environment and retrieves the rank and size of the MPI communicator.
+ * @param total The 3x3 sums.
+ * @return All ones in the bytes whose sum is in Sums.
  */
-void GameOfLife::initializeMPI(int argc, char **argv)
+template <unsigned Sums, int Sum = 0>
+__attribute__((target("avx2")))
+static inline __m256i matchAvx2(__m256i total)
 {
-    MPI_Init(&argc, &argv);
-    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-    MPI_Comm_size(MPI_COMM_WORLD, &noRanks);
+    if constexpr (Sum > RULE_MAX_SUM)
+        return _mm256_setzero_si256();
+    else if constexpr (((Sums >> Sum) & 1) == 0)
+        return matchAvx2<Sums, Sum + 1>(total);
+    else
+        return _mm256_or_si256(_mm256_cmpeq_epi8(total, _mm256_set1_epi8(Sum)), matchAvx2<Sums, Sum + 1>(total));
 }
 
 
 /**
- * Reads the input file and initializes the simulation grid (by creating
- *  the number of processes as the count of the rows).
+ * Row kernel with AVX2 (32 cells per step).
  *
- * @param filename Name of the input file.
- * @brief Reads the input file and initializes the simulation grid based on the contents of the file.
+ * @brief Same computation as rowKernelScalar, the comparisons are byte comparisons and masks.
+ *  The table lookup is one byte shuffle for the dead and one for the live cells (the sums 0..9
+ *  index the 16 bytes of a lane), blended by the state of the cell.
+ *  The last step may compute cells past the tile, they land in the ghost column and the row
+ *  padding, which are overwritten by the next halo exchange or never read.
  */
-void GameOfLife::readInputFile(const std::string &filename)
+template <uint16_t Birth, uint16_t Survival>
+__attribute__((target("avx2")))
+static void rowKernelAvx2(const uint8_t *above, const uint8_t *row, const uint8_t *below,
+                          uint8_t *next, uint8_t *sums, int cols, const uint8_t *table)
 {
-    if (rank == 0)
+    const int width = 32;
+    for (int j = 0; j <= cols + width; j += width)
     {
-        // Read the file and store lines in a vector
-        std::ifstream file(filename);
-        if (!file.is_open())
-        {
-            std::cerr << "Error opening file" << std::endl;
-            MPI_Abort(MPI_COMM_WORLD, 1);
-        }
-
-        std::vector<std::string> lines;
-        std::string line;
-        while (getline(file, line))
-        {
-            lines.push_back(line);
-        }
-        file.close();
+        __m256i sum = _mm256_add_epi8(_mm256_loadu_si256((const __m256i *)(above + j)),
+                                      _mm256_loadu_si256((const __m256i *)(row + j)));
+        sum = _mm256_add_epi8(sum, _mm256_loadu_si256((const __m256i *)(below + j)));
+        _mm256_storeu_si256((__m256i *)(sums + j), sum);
+    }
 
-        if (lines.size() > 1)
+    constexpr unsigned born = Birth, stays = unsigned(Survival) << 1;
+    constexpr bool compare = Birth != RULE_RUNTIME_MASK && __builtin_popcount(born | stays) <= RULE_COMPARES;
+    static constexpr RuleTable fixedTable = buildRuleTable(Birth, Survival);
+    const uint8_t *rules = Birth == RULE_RUNTIME_MASK ? table : fixedTable.data();
+    const __m256i deadTable = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)rules));
+    const __m256i aliveTable = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)(rules + RULE_TABLE)));
+    const __m256i one = _mm256_set1_epi8(1);
+    for (int j = 1; j <= cols; j += width)
+    {
+        __m256i total = _mm256_add_epi8(_mm256_loadu_si256((const __m256i *)(sums + j - 1)),
+                                        _mm256_loadu_si256((const __m256i *)(sums + j)));
+        total = _mm256_add_epi8(total, _mm256_loadu_si256((const __m256i *)(sums + j + 1)));
+        __m256i alive = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(row + j)), one);
+        __m256i lives;
+        if constexpr (compare)
         {
-            const std::string &line = lines[0];
-            line_length = line.size();
-
-            current_line_in_ints.push_back(0); // Add a ghost cell
-            for (char c : line)
-            {
-                current_line_in_ints.push_back(c - '0');
-            }
-            current_line_in_ints.push_back(0); // Add a ghost cell
-
-            MPI_Bcast(&line_length, 1, MPI_INT, 0, MPI_COMM_WORLD);
+            lives = matchAvx2<born & stays>(total);
+            if constexpr ((born & ~stays) != 0)
+                lives = _mm256_or_si256(lives, _mm256_andnot_si256(alive, matchAvx2<born & ~stays>(total)));
+            if constexpr ((stays & ~born) != 0)
+                lives = _mm256_or_si256(lives, _mm256_and_si256(alive, matchAvx2<stays & ~born>(total)));
+            lives = _mm256_and_si256(lives, one);
         }
-
-        for (int i = 1; i < lines.size(); i++)
+        else
         {
-            if (lines[i].size() == line_length)
-            {
-                const std::string &line = lines[i];
-                std::vector<int> line_data;
-                for (char c : line)
-                {
-                    line_data.push_back(c - '0');
-                }
-                line_data.pop_back();
-                MPI_Send(line_data.data(), line_length, MPI_INT, i, 0, MPI_COMM_WORLD);
-            }
-            else
-            {
-                std::cerr << "0: [Error]: The lines are not the same length." << std::endl;
-                std::cerr << "0: The error occurred at line " << i << " it's len is: " << lines[i].size() << std::endl;
-                MPI_Abort(MPI_COMM_WORLD, 1);
-            }
+            lives = _mm256_blendv_epi8(_mm256_shuffle_epi8(deadTable, total), _mm256_shuffle_epi8(aliveTable, total), alive);
         }
+        _mm256_storeu_si256((__m256i *)(next + j), lives);
     }
-    else
-    {
-        MPI_Bcast(&line_length, 1, MPI_INT, 0, MPI_COMM_WORLD);
-        std::vector<int> received_line(line_length, 0);
-        MPI_Recv(received_line.data(), line_length, MPI_INT, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-        current_line_in_ints.push_back(0);
-        current_line_in_ints.insert(current_line_in_ints.end(), received_line.begin(), received_line.end());
-        current_line_in_ints.push_back(0);
-    }
-
-    currGrid.assign(N_ROWS_LOCAL_W_GHOST, current_line_in_ints);
-    nextGrid.assign(N_ROWS_LOCAL_W_GHOST, current_line_in_ints);
 }
 
 
 /**
- * Communicates boundary rows between MPI processes.
- * 
- * @brief Sends and receives boundary rows between adjacent MPI processes.
+ * Tests 64 3x3 sums against a set known at compile time (AVX-512).
+ *
+ * @param total The 3x3 sums.
+ * @return The mask of the bytes whose sum is in Sums.
  */
-void GameOfLife::communicateBoundaryRows()
+template <unsigned Sums, int Sum = 0>
+__attribute__((target("avx512f,avx512bw")))
+static inline __mmask64 matchAvx512(__m512i total)
 {
-    auto upperNeighbour = (rank - 1 + noRanks) % noRanks;
-    auto lowerNeighbour = (rank + 1) % noRanks;
-
-    MPI_Send(&currGrid[1][1], line_length, MPI_INT, upperNeighbour, 0, MPI_COMM_WORLD);
-    MPI_Send(&currGrid[1][1], line_length, MPI_INT, lowerNeighbour, 0, MPI_COMM_WORLD);
-
-    MPI_Recv(&currGrid[0][1], line_length, MPI_INT, upperNeighbour, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-    MPI_Recv(&currGrid[2][1], line_length, MPI_INT, lowerNeighbour, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-
-    currGrid[0][0] = currGrid[0][line_length];
-    currGrid[0][line_length + 1] = currGrid[0][1];
-    currGrid[1][0] = currGrid[1][line_length];
-    currGrid[1][line_length + 1] = currGrid[1][1];
-    currGrid[2][0] = currGrid[2][line_length];
-    currGrid[2][line_length + 1] = currGrid[2][1];
+    if constexpr (Sum > RULE_MAX_SUM)
+        return 0;
+    else if constexpr (((Sums >> Sum) & 1) == 0)
+        return matchAvx512<Sums, Sum + 1>(total);
+    else
+        return _mm512_cmpeq_epi8_mask(total, _mm512_set1_epi8(Sum)) | matchAvx512<Sums, Sum + 1>(total);
 }
 
 
 /**
- * Calculates the next state of the grid based on the current state.
- * 
- * @brief Applies the rules of the Game of Life to calculate the next state of the grid.
+ * Row kernel with AVX-512 (64 cells per step).
+ *
+ * @brief Same computation as rowKernelAvx2, the comparisons produce mask registers and the
+ *  result is a masked move of ones, the shuffled tables are blended by the mask of the live cells.
  */
-void GameOfLife::calculateNextGrid()
+template <uint16_t Birth, uint16_t Survival>
+__attribute__((target("avx512f,avx512bw")))
+static void rowKernelAvx512(const uint8_t *above, const uint8_t *row, const uint8_t *below,
+                            uint8_t *next, uint8_t *sums, int cols, const uint8_t *table)
 {
-    for (auto j = 1; j <= line_length; j++)
+    const int width = 64;
+    for (int j = 0; j <= cols + width; j += width)
     {
-        int aliveNeighbours = 0;
-        for (auto x = -1; x <= 1; x++)
-        {
-            for (auto y = -1; y <= 1; y++)
-            {
-                if (x == 0 && y == 0)
-                    continue;
-                if (currGrid[1 + x][j + y] == ALIVE_CELL)
-                    aliveNeighbours++;
-            }
-        }
+        __m512i sum = _mm512_add_epi8(_mm512_loadu_si512(above + j), _mm512_loadu_si512(row + j));
+        _mm512_storeu_si512(sums + j, _mm512_add_epi8(sum, _mm512_loadu_si512(below + j)));
+    }
 
-        if (currGrid[1][j] == ALIVE_CELL)
+    constexpr unsigned born = Birth, stays = unsigned(Survival) << 1;
+    constexpr bool compare = Birth != RULE_RUNTIME_MASK && __builtin_popcount(born | stays) <= RULE_COMPARES;
+    static constexpr RuleTable fixedTable = buildRuleTable(Birth, Survival);
+    const uint8_t *rules = Birth == RULE_RUNTIME_MASK ? table : fixedTable.data();
+    // The tables in every lane (the zero-masked broadcast, the plain one has an undefined source GCC warns about)
+    const __m512i deadTable = _mm512_maskz_broadcast_i32x4(UINT16_MAX, _mm_loadu_si128((const __m128i *)rules));
+    const __m512i aliveTable = _mm512_maskz_broadcast_i32x4(UINT16_MAX, _mm_loadu_si128((const __m128i *)(rules + RULE_TABLE)));
+    const __m512i one = _mm512_set1_epi8(1);
+    for (int j = 1; j <= cols; j += width)
+    {
+        __m512i total = _mm512_add_epi8(_mm512_loadu_si512(sums + j - 1), _mm512_loadu_si512(sums + j));
+        total = _mm512_add_epi8(total, _mm512_loadu_si512(sums + j + 1));
+        __m512i cells = _mm512_loadu_si512(row + j);
+        __mmask64 alive = _mm512_test_epi8_mask(cells, cells);
+        if constexpr (compare)
         {
-            if (aliveNeighbours < 2 || aliveNeighbours > 3)
-            {
-                nextGrid[1][j] = DEAD_CELL;
-            }
-            else
-            {
-                nextGrid[1][j] = ALIVE_CELL;
-            }
+            __mmask64 lives = matchAvx512<born & stays>(total) | (matchAvx512<born & ~stays>(total) & ~alive) |
+                              (matchAvx512<stays & ~born>(total) & alive);
+            _mm512_storeu_si512(next + j, _mm512_maskz_mov_epi8(lives, one));
         }
         else
         {
-            if (aliveNeighbours == 3)
-            {
-                nextGrid[1][j] = ALIVE_CELL;
-            }
-            else
-            {
-                nextGrid[1][j] = DEAD_CELL;
-            }
+            _mm512_storeu_si512(next + j, _mm512_mask_blend_epi8(alive, _mm512_shuffle_epi8(deadTable, total),
+                                                                 _mm512_shuffle_epi8(aliveTable, total)));
         }
     }
 }
+#endif
 
 
 /**
- * Swaps the current grid with the next grid.
- * 
- * @brief Swaps the current grid with the next grid for the next iteration of the simulation.
+ * Picks the widest byte kernel supported by the CPU.
+ *
+ * @return The kernel.
  */
-void GameOfLife::swapGrids()
+static Kernel bestKernel()
 {
-    currGrid.swap(nextGrid);
+#ifdef HAVE_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512bw"))
+        return KERNEL_AVX512;
+    if (__builtin_cpu_supports("avx2"))
+        return KERNEL_AVX2;
+#endif
+    return KERNEL_SCALAR;
 }
 
 
 /**
- * Prints the grid state.
- * 
- * @brief Prints the current state of the grid to the standard output.
+ * Returns the row kernel of a byte kernel for a rule known at compile time.
+ *
+ * @param kernel The kernel.
+ * @return The row kernel, nullptr if the CPU does not support it (or for the bits kernel).
  */
-void GameOfLife::printGrid()
+template <uint16_t Birth, uint16_t Survival>
+static RowKernel selectRowKernel(Kernel kernel)
 {
-    if (rank != 0)
+    switch (kernel)
     {
-        MPI_Send(&currGrid[1][1], line_length, MPI_INT, 0, 0, MPI_COMM_WORLD);
+    case KERNEL_SCALAR:
+        return rowKernelScalar<Birth, Survival>;
+#ifdef HAVE_X86_KERNELS
+    case KERNEL_AVX2:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") ? rowKernelAvx2<Birth, Survival> : nullptr;
+    case KERNEL_AVX512:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx512bw") ? rowKernelAvx512<Birth, Survival> : nullptr;
+#endif
+    default:
+        return nullptr;
     }
-    else
+}
+
+
+/**
+ * Returns the row kernel of a byte kernel.
+ *
+ * @param kernel The kernel.
+ * @param rule The rule.
+ * @return The row kernel (specialized for the common rules, the kernel of the runtime rule for the
+ *  others), nullptr if the CPU does not support it (or for the bits kernel).
+ */
+static RowKernel selectRowKernel(Kernel kernel, const Rule &rule)
+{
+    if (rule == Rule{RULE_LIFE})
+        return selectRowKernel<RULE_LIFE>(kernel);
+    if (rule == Rule{RULE_HIGHLIFE})
+        return selectRowKernel<RULE_HIGHLIFE>(kernel);
+    if (rule == Rule{RULE_DAY_AND_NIGHT})
+        return selectRowKernel<RULE_DAY_AND_NIGHT>(kernel);
+    if (rule == Rule{RULE_SEEDS})
+        return selectRowKernel<RULE_SEEDS>(kernel);
+    return selectRowKernel<RULE_RUNTIME>(kernel);
+}
+
+
+/**
+ * Parses a rule.
+ *
+ * @param text The rule: B<counts>/S<counts> (the slash may be left out, the letters may be lower case)
+ *  or <survival counts>/<birth counts>, the counts are digits from 0 to 8.
+ * @param rule The rule (set if the text is valid).
+ * @return false if the text is not a rule.
+ */
+static bool parseRule(const std::string &text, Rule &rule)
+{
+    // Mask of the counts text[begin..end), -1 if there is another character
+    auto counts = [&](size_t begin, size_t end)
     {
-        std::vector<int> allRows(line_length, 0);
-        for (size_t i = 0; i < line_length; ++i)
-        {
-            allRows[i] = currGrid[1][i + 1];
-        }
-        std::cout << "0: ";
-        for (auto cell : allRows)
+        int mask = 0;
+        for (size_t i = begin; i < end; i++)
         {
-            std::cout << cell;
+            if (text[i] < '0' || text[i] > '8')
+            {
+                return -1;
+            }
+            mask |= 1 << (text[i] - '0');
         }
-        std::cout << std::endl;
+        return mask;
+    };
 
-        for (auto i = 1; i < noRanks; i++)
+    int birth, survival;
+    const size_t slash = text.find('/');
+    if (!text.empty() && toupper((unsigned char)text[0]) == 'B')
+    {
+        const size_t letter = text.find_first_of("Ss");
+        if (letter == std::string::npos || (slash != std::string::npos && slash + 1 != letter))
         {
-            MPI_Recv(allRows.data(), line_length, MPI_INT, i, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-            std::cout << i << ": ";
-            for (auto cell : allRows)
-            {
-                std::cout << cell;
-            }
-            std::cout << std::endl;
+            return false;
         }
+        birth = counts(1, slash != std::string::npos ? slash : letter);
+        survival = counts(letter + 1, text.size());
+    }
+    else if (slash != std::string::npos)
+    {
+        survival = counts(0, slash);
+        birth = counts(slash + 1, text.size());
+    }
+    else
+    {
+        return false;
+    }
+
+    if (birth < 0 || survival < 0)
+    {
+        return false;
     }
+    rule.birth = birth;
+    rule.survival = survival;
+    return true;
 }
 
 
 /**
- * Runs the Game of Life simulation.
- * 
- * @brief Executes the main simulation loop for the specified number of time steps.
+ * Formats a rule.
+ *
+ * @param rule The rule.
+ * @return The rule in the B/S notation (e.g. B3/S23).
  */
-void GameOfLife::runSimulation()
+static std::string ruleName(const Rule &rule)
 {
-    for (auto currTime = 0; currTime < gameTime; currTime++)
+    std::string name = "B";
+    for (int count = 0; count < RULE_COUNTS; count++)
+    {
+        if ((rule.birth >> count) & 1)
+        {
+            name += char('0' + count);
+        }
+    }
+    name += "/S";
+    for (int count = 0; count < RULE_COUNTS; count++)
     {
-        communicateBoundaryRows();
-        calculateNextGrid();
-        swapGrids();
+        if ((rule.survival >> count) & 1)
+        {
+            name += char('0' + count);
+        }
     }
-
-    printGrid();
+    return name;
 }
 
 
 /**
- * Entry point for the Game of Life program.
- * 
+ * Constructor for the GameOfLife class.
+ *
  * @param argc Number of command-line arguments.
  * @param argv Array of command-line arguments.
- * @return Returns 0 upon successful execution of the program.
- * @brief Parses command-line arguments, initializes the GameOfLife object, runs the simulation, and returns the result.
+ * @brief Initializes MPI and retrieves the game time from command-line arguments.
  */
-int main(int argc, char **argv)
+GameOfLife::GameOfLife(int argc, char **argv)
 {
-    if (argc != 3)
+    initializeMPI(argc, argv);
+
+    if (argc < 3)
     {
-        fprintf(stderr, "Usage: %s <file.txt> <game time>\n", argv[0]);
-        return 1;
+        fprintf(stderr, "Usage: %s <file.txt> <game time> [-k auto|scalar|avx2|avx512|bits] [-g width|auto] [-t threads] [-a] [-e grid|hashlife] [-o file] [-c nodes] [-s generations] [-f file] [-r] [-q] [-n processes] [-d tiles|rows] [-p period] [-b rule]\n", argv[0]);
+        MPI_Abort(MPI_COMM_WORLD, 1);
     }
 
-    GameOfLife game(argc, argv);
-    game.readInputFile(argv[1]);
-    game.runSimulation();
+    // Get time argument from command line
+    gameTime = atoll(argv[2]);
 
-    return 0;
-}
\ No newline at end of file
+    // Options follow the file and the game time. getopt is reset fully (optind = 0), so that a program
+    // creating several games (life_harness.cpp) never continues in the arguments of the previous one
+    std::vector<char *> options = {argv[0]};
+    options.insert(options.end(), argv + 3, argv + argc);
+    optind = 0;
+    int opt;
+    while ((opt = getopt(int(options.size()), options.data(), LIFE_OPTIONS)) != -1)
+    {
+        switch (opt)
+        {
+        case 'k':
+            if (std::string(optarg) == "auto")
+                kernel = KERNEL_AUTO;
+            else if (std::string(optarg) == "scalar")
+                kernel = KERNEL_SCALAR;
+            else if (std::string(optarg) == "avx2")
+                kernel = KERNEL_AVX2;
+            else if (std::string(optarg) == "avx512")
+                kernel = KERNEL_AVX512;
+            else if (std::string(optarg) == "bits")
+                kernel = KERNEL_BITS;
+            else
+            {
+                fprintf(stderr, "Unknown kernel: %s\n", optarg);
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+            break;
+        case 'g':
+            if (std::string(optarg) == "auto")
+            {
+                tuneGhosts = true;
+                break;
+            }
+            ghostWidth = atoi(optarg);
+            if (ghostWidth < 1)
+            {
+                fprintf(stderr, "Ghost width must be a positive number.\n");
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+            break;
+        case 't':
+            noThreads = atoi(optarg);
+            if (noThreads < 1)
+            {
+                fprintf(stderr, "Number of threads must be a positive number.\n");
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+            break;
+        case 'a':
+            trackActivity = true;
+            break;
+        case 'e':
+            if (std::string(optarg) == "grid")
+                engine = ENGINE_GRID;
+            else if (std::string(optarg) == "hashlife")
+                engine = ENGINE_HASHLIFE;
+            else
+            {
+                fprintf(stderr, "Unknown engine: %s\n", optarg);
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+            break;
+        case 'o':
+            outputPath = optarg;
+            break;
+        case 'c':
+            cacheNodes = atoll(optarg);
+            if (cacheNodes < 1)
+            {
+                fprintf(stderr, "Size of the node cache must be a positive number.\n");
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+            break;
+        case 's':
+            checkpointInterval = atoll(optarg);
+            if (checkpointInterval < 1)
+            {
+                fprintf(stderr, "Checkpoint interval must be a positive number.\n");
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+            break;
+        case 'f':
+            checkpointPath = optarg;
+            break;
+        case 'r':
+            restart = true;
+            break;
+        case 'q':
+            printResult = false;
+            break;
+        case 'n':
+            maxRanks = atoi(optarg);
+            if (maxRanks < 1)
+            {
+                fprintf(stderr, "Number of processes must be a positive number.\n");
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+            break;
+        case 'd':
+            if (std::string(optarg) == "tiles")
+                layout = LAYOUT_TILES;
+            else if (std::string(optarg) == "rows")
+                layout = LAYOUT_ROWS;
+            else
+            {
+                fprintf(stderr, "Unknown layout: %s\n", optarg);
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+            break;
+        case 'p':
+            cyclePeriods = atoi(optarg);
+            if (cyclePeriods < 1)
+            {
+                fprintf(stderr, "Longest period must be a positive number.\n");
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+            break;
+        case 'b':
+            if (!parseRule(optarg, rule))
+            {
+                fprintf(stderr, "Unknown rule: %s\n", optarg);
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+            ruleGiven = true;
+            break;
+        default:
+            fprintf(stderr, "Usage: %s <file.txt> <game time> [-k auto|scalar|avx2|avx512|bits] [-g width|auto] [-t threads] [-a] [-e grid|hashlife] [-o file] [-c nodes] [-s generations] [-f file] [-r] [-q] [-n processes] [-d tiles|rows] [-p period] [-b rule]\n", argv[0]);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+
+    if (engine == ENGINE_HASHLIFE && gameTime >= (2LL << HASHLIFE_MAX_POWER))
+    {
+        fprintf(stderr, "Game time is too large for the HashLife engine.\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    if (kernel == KERNEL_AUTO)
+    {
+        kernel = bestKernel();
+    }
+    setRule(rule);
+    if (kernel != KERNEL_BITS && rowKernel == nullptr)
+    {
+        fprintf(stderr, "The kernel is not supported by this CPU.\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    if (kernel == KERNEL_BITS && (ghostWidth != 1 || tuneGhosts))
+    {
+        fprintf(stderr, "Wide ghost zones (-g) need a byte kernel.\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    if (trackActivity && (kernel == KERNEL_BITS || ghostWidth != 1 || tuneGhosts))
+    {
+        fprintf(stderr, "Active blocks (-a) need a byte kernel with ghost width 1.\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    if (noThreads > 1 && threadLevel < MPI_THREAD_FUNNELED)
+    {
+        fprintf(stderr, "The MPI library does not support threads.\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    createThreads();
+}
+
+
+/**
+ * Destructor for the GameOfLife class.
+ *
+ * @brief Stops the threads and finalizes MPI.
+ */
+GameOfLife::~GameOfLife()
+{
+    joinThreads();
+    if (cartComm != MPI_COMM_NULL)
+    {
+        MPI_Comm_free(&cartComm);
+    }
+    if (ownsMPI)
+    {
+        MPI_Finalize();
+    }
+}
+
+
+/**
+ * Initializes MPI.
+ *
+ * @param argc Number of command-line arguments.
+ * @param argv Array of command-line arguments.
+ * @brief Initializes MPI environment and retrieves the rank and size of the MPI communicator.
+ *  Only the main thread calls MPI (MPI_THREAD_FUNNELED). MPI initialized by the program the engine
+ *  is built into is used as it is.
+ */
+void GameOfLife::initializeMPI(int argc, char **argv)
+{
+    int initialized;
+    MPI_Initialized(&initialized);
+    if (initialized)
+    {
+        MPI_Query_thread(&threadLevel);
+    }
+    else
+    {
+        MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &threadLevel);
+        ownsMPI = true;
+    }
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &noRanks);
+}
+
+
+/**
+ * Sets the rule of the automaton.
+ *
+ * @param newRule The rule.
+ * @brief Builds the rule table and picks the kernels of the rule: the kernels specialized at compile
+ *  time for the common rules, the kernels reading the rule table (byte kernels) or the rule masks
+ *  (bits kernel) for the others. rowKernel is nullptr if the CPU does not support the byte kernel.
+ */
+void GameOfLife::setRule(const Rule &newRule)
+{
+    rule = newRule;
+    ruleTable = buildRuleTable(rule.birth, rule.survival);
+    rowKernel = selectRowKernel(kernel, rule);
+
+    if (rule == Rule{RULE_LIFE})
+        bitsKernel = &GameOfLife::calculateNextBits<RULE_LIFE>;
+    else if (rule == Rule{RULE_HIGHLIFE})
+        bitsKernel = &GameOfLife::calculateNextBits<RULE_HIGHLIFE>;
+    else if (rule == Rule{RULE_DAY_AND_NIGHT})
+        bitsKernel = &GameOfLife::calculateNextBits<RULE_DAY_AND_NIGHT>;
+    else if (rule == Rule{RULE_SEEDS})
+        bitsKernel = &GameOfLife::calculateNextBits<RULE_SEEDS>;
+    else
+        bitsKernel = &GameOfLife::calculateNextBits<RULE_RUNTIME>;
+}
+
+
+/**
+ * Returns the format of a grid file.
+ *
+ * @param path Path of the file.
+ * @return RLE for .rle, binary for .bin, text otherwise.
+ */
+static GridFormat gridFormat(const std::string &path)
+{
+    auto endsWith = [&](const std::string &suffix)
+    {
+        return path.size() >= suffix.size() && path.compare(path.size() - suffix.size(), suffix.size(), suffix) == 0;
+    };
+    if (endsWith(".rle"))
+    {
+        return FORMAT_RLE;
+    }
+    return endsWith(".bin") ? FORMAT_BINARY : FORMAT_TEXT;
+}
+
+
+/**
+ * Reads the input file and initializes the simulation grid (by splitting the grid
+ *  into tiles of the Cartesian process grid).
+ *
+ * @param filename Name of the input file.
+ * @brief The first process reads the size of the grid, then all processes read their tiles
+ *  with collective MPI-IO (the idle processes read nothing). HashLife reads the whole grid
+ *  on the first process. A restart reads the latest checkpoint instead (if there is one).
+ */
+void GameOfLife::readInputFile(const std::string &filename)
+{
+    GridFormat format = gridFormat(filename);
+    MPI_File file;
+    MPI_Offset body;
+    int lineLength = 0;
+    if (restart && findCheckpoint(file, body))
+    {
+        format = FORMAT_CHECKPOINT;
+    }
+    else
+    {
+        if (MPI_File_open(MPI_COMM_WORLD, filename.c_str(), MPI_MODE_RDONLY, MPI_INFO_NULL, &file) != MPI_SUCCESS)
+        {
+            // All processes fail, the first one reports it
+            if (rank == 0)
+            {
+                std::cerr << "Error opening file" << std::endl;
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+            MPI_Barrier(MPI_COMM_WORLD);
+        }
+        readGridHeader(file, format, body, lineLength);
+    }
+
+    int row, col, rows, cols;
+    assignTile(row, col, rows, cols);
+    std::vector<uint8_t> tile = readTile(file, format, body, lineLength, row, col, rows, cols);
+    MPI_File_close(&file);
+    placeTile(tile);
+}
+
+
+/**
+ * Generates a random grid (instead of reading the input file).
+ *
+ * @param rows Rows of the grid.
+ * @param cols Columns of the grid.
+ * @param density Probability of a live cell.
+ * @param seed Seed of the grid.
+ * @brief Every process generates its tile, a cell depends only on the seed and its position,
+ *  so the grid is the same for any number of processes and layout.
+ */
+void GameOfLife::generateGrid(int rows, int cols, double density, uint64_t seed)
+{
+    globalRows = rows;
+    globalCols = cols;
+    int row, col, tileRows, tileCols;
+    assignTile(row, col, tileRows, tileCols);
+
+    const uint64_t threshold = density >= 1 ? UINT64_MAX : uint64_t(density * 18446744073709551616.0);
+    std::vector<uint8_t> tile(size_t(tileRows) * tileCols);
+    for (int i = 0; i < tileRows; i++)
+    {
+        for (int j = 0; j < tileCols; j++)
+        {
+            // splitmix64 of the position
+            uint64_t x = seed + (uint64_t(row + i) * cols + col + j + 1) * HASH_MULTIPLIER;
+            x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+            tile[size_t(i) * tileCols + j] = (x ^ (x >> 31)) < threshold ? ALIVE_CELL : DEAD_CELL;
+        }
+    }
+    placeTile(tile);
+}
+
+
+/**
+ * Creates the tiles and returns the part of the grid this process holds.
+ *
+ * @param row First row of the part.
+ * @param col First column of the part.
+ * @param rows Rows of the part (0 if the process holds nothing).
+ * @param cols Columns of the part.
+ * @brief HashLife holds the whole grid on the first process.
+ */
+void GameOfLife::assignTile(int &row, int &col, int &rows, int &cols)
+{
+    row = col = rows = cols = 0;
+    if (engine == ENGINE_HASHLIFE)
+    {
+        if (rank == 0)
+        {
+            rows = globalRows;
+            cols = globalCols;
+        }
+        return;
+    }
+
+    createDecomposition();
+    if (cartComm != MPI_COMM_NULL)
+    {
+        row = firstRow;
+        col = firstCol;
+        rows = localRows;
+        cols = localCols;
+    }
+}
+
+
+/**
+ * Initializes the simulation with the part of the grid this process holds.
+ *
+ * @param tile The cells of the part (from assignTile), row by row.
+ */
+void GameOfLife::placeTile(std::vector<uint8_t> &tile)
+{
+    if (engine == ENGINE_HASHLIFE)
+    {
+        wholeGrid.swap(tile);
+        return;
+    }
+    if (cartComm == MPI_COMM_NULL)
+    {
+        return;
+    }
+
+    // A halo strip is taken from the interior of the neighbour tile, so the smallest tile limits the ghost width
+    int widthLimit = std::min(localRows, localCols);
+    MPI_Allreduce(MPI_IN_PLACE, &widthLimit, 1, MPI_INT, MPI_MIN, cartComm);
+    ghostWidth = std::min(ghostWidth, widthLimit);
+
+    allocateGrids();
+    setTile(tile.data());
+}
+
+
+/**
+ * Reads the size of the grid (first process) and broadcasts it.
+ *
+ * @param file The input file.
+ * @param format Format of the file.
+ * @param body Offset of the cells in the file.
+ * @param lineLength Length of a line of the text format (with the end of line).
+ * @brief Sets globalRows and globalCols. The text format takes the columns from the first line and
+ *  the rows from the size of the file (empty lines at its end are not rows), RLE and binary have a header.
+ *  The rule of an RLE header is used unless a rule was given (-b).
+ */
+void GameOfLife::readGridHeader(MPI_File file, GridFormat format, MPI_Offset &body, int &lineLength)
+{
+    // Rows, columns, offset of the cells, line length, birth and survival masks of the file (-1 for none)
+    long long header[6] = {0, 0, 0, 0, -1, -1};
+    if (rank == 0)
+    {
+        auto fail = [](const char *message)
+        {
+            std::cerr << "0: [Error]: " << message << std::endl;
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        };
+
+        MPI_Offset size;
+        MPI_File_get_size(file, &size);
+        std::string start;
+        auto readMore = [&]()
+        {
+            int count = std::min<MPI_Offset>(HEADER_CHUNK, size - MPI_Offset(start.size()));
+            if (count <= 0)
+            {
+                return false;
+            }
+            std::vector<char> chunk(count);
+            MPI_File_read_at(file, start.size(), chunk.data(), count, MPI_CHAR, MPI_STATUS_IGNORE);
+            start.append(chunk.begin(), chunk.end());
+            return true;
+        };
+
+        long long rows = 0, cols = 0;
+        MPI_Offset offset = 0;
+        int length = 0;
+        if (format == FORMAT_TEXT)
+        {
+            size_t end;
+            while ((end = start.find('\n')) == std::string::npos && readMore())
+            {
+            }
+            cols = end == std::string::npos ? start.size() : end;
+            int eol = 1;
+            if (cols > 0 && start[cols - 1] == '\r')
+            {
+                cols--;
+                eol = 2;
+            }
+            if (cols == 0)
+            {
+                fail("The input grid is empty.");
+            }
+            length = cols + eol;
+
+            // The last line may miss the end of line, anything else after the last full line must be empty lines
+            rows = size / length;
+            MPI_Offset rest = size % length;
+            if (rest >= cols)
+            {
+                rows++;
+            }
+            else if (rest > 0)
+            {
+                std::vector<char> tail(rest);
+                MPI_File_read_at(file, size - rest, tail.data(), rest, MPI_CHAR, MPI_STATUS_IGNORE);
+                for (char c : tail)
+                {
+                    if (c != '\n' && c != '\r')
+                    {
+                        fail("The lines are not the same length.");
+                    }
+                }
+            }
+        }
+        else if (format == FORMAT_RLE)
+        {
+            // Comment lines (#) and empty lines, then the header line "x = <columns>, y = <rows>[, rule = <rule>]"
+            while (true)
+            {
+                size_t end;
+                while ((end = start.find('\n', offset)) == std::string::npos && readMore())
+                {
+                }
+                std::string line = start.substr(offset, end == std::string::npos ? std::string::npos : end - offset);
+                offset = end == std::string::npos ? start.size() : end + 1;
+                line.erase(std::remove_if(line.begin(), line.end(), [](char c) { return isspace((unsigned char)c); }), line.end());
+                if (!line.empty() && line[0] == '#')
+                {
+                    continue;
+                }
+                if (line.empty() && end != std::string::npos)
+                {
+                    continue;
+                }
+
+                char name[64] = "";
+                if (sscanf(line.c_str(), "x=%lld,y=%lld,rule=%63[^,]", &cols, &rows, name) < 2)
+                {
+                    fail("The RLE header (x = <columns>, y = <rows>) is missing.");
+                }
+                Rule fileRule;
+                if (name[0] != '\0')
+                {
+                    if (!parseRule(name, fileRule))
+                    {
+                        fail("Unknown rule in the RLE header.");
+                    }
+                    header[4] = fileRule.birth;
+                    header[5] = fileRule.survival;
+                }
+                break;
+            }
+        }
+        else
+        {
+            char data[BINARY_HEADER_SIZE] = {};
+            uint32_t size32[2] = {0, 0};
+            if (size >= BINARY_HEADER_SIZE)
+            {
+                MPI_File_read_at(file, 0, data, BINARY_HEADER_SIZE, MPI_CHAR, MPI_STATUS_IGNORE);
+            }
+            if (size < BINARY_HEADER_SIZE || memcmp(data, BINARY_MAGIC, strlen(BINARY_MAGIC)) != 0)
+            {
+                fail("The binary grid has no header.");
+            }
+            memcpy(size32, data + strlen(BINARY_MAGIC), sizeof(size32));
+            rows = size32[0];
+            cols = size32[1];
+            offset = BINARY_HEADER_SIZE;
+            if (size < offset + rows * ((cols + 7) / 8))
+            {
+                fail("The binary grid is truncated.");
+            }
+        }
+
+        if (rows <= 0 || cols <= 0 || rows > INT32_MAX || cols > INT32_MAX)
+        {
+            fail("The input grid is empty.");
+        }
+        header[0] = rows;
+        header[1] = cols;
+        header[2] = offset;
+        header[3] = length;
+    }
+
+    MPI_Bcast(header, 6, MPI_LONG_LONG, 0, MPI_COMM_WORLD);
+    globalRows = header[0];
+    globalCols = header[1];
+    body = header[2];
+    lineLength = header[3];
+    if (header[4] >= 0 && !ruleGiven)
+    {
+        setRule(Rule{uint16_t(header[4]), uint16_t(header[5])});
+    }
+}
+
+
+/**
+ * Reads the tile of this process (collective).
+ *
+ * @param file The input file.
+ * @param format Format of the file.
+ * @param body Offset of the cells in the file.
+ * @param lineLength Length of a line of the text format.
+ * @param row First row of the tile.
+ * @param col First column of the tile.
+ * @param rows Rows of the tile (0 if the process has no tile).
+ * @param cols Columns of the tile.
+ * @return The cells of the tile, row by row.
+ * @brief Text and binary tiles are read through a subarray view of the file. The tiles at the east
+ *  edge also read the ends of their lines, so every line is checked.
+ */
+std::vector<uint8_t> GameOfLife::readTile(MPI_File file, GridFormat format, MPI_Offset body, int lineLength,
+                                          int row, int col, int rows, int cols)
+{
+    std::vector<uint8_t> tile(size_t(rows) * cols, DEAD_CELL);
+    InputError error = INPUT_OK;
+    if (format == FORMAT_RLE)
+    {
+        readRleTile(file, body, row, col, cols, tile);
+    }
+    else if (format == FORMAT_TEXT)
+    {
+        const int eol = col + cols == globalCols ? lineLength - globalCols : 0, count = cols + eol;
+        const char *endOfLine = eol == 2 ? "\r\n" : "\n";
+        std::vector<char> data(size_t(rows) * count);
+        transferRect(file, body, lineLength, row, col, rows, count, data.data(), false);
+        if (eol > 0 && row + rows == globalRows)
+        {
+            // The last line may miss its end of line (the bytes after the end of the file are undefined)
+            MPI_Offset size;
+            MPI_File_get_size(file, &size);
+            MPI_Offset missing = body + (MPI_Offset)globalRows * lineLength - size;
+            if (missing > 0)
+            {
+                std::copy(endOfLine + eol - missing, endOfLine + eol, data.end() - missing);
+            }
+        }
+
+        for (int i = 0; i < rows && error == INPUT_OK; i++)
+        {
+            const char *line = &data[size_t(i) * count];
+            for (int j = 0; j < cols; j++)
+            {
+                if (line[j] == '0' || line[j] == '1')
+                {
+                    tile[size_t(i) * cols + j] = line[j] - '0';
+                }
+                else
+                {
+                    error = line[j] == '\n' || line[j] == '\r' ? INPUT_LINE_LENGTH : INPUT_CHARACTER;
+                    break;
+                }
+            }
+            if (!std::equal(line + cols, line + count, endOfLine))
+            {
+                error = INPUT_LINE_LENGTH;
+            }
+        }
+    }
+    else if (format == FORMAT_CHECKPOINT)
+    {
+        transferRect(file, body, globalCols, row, col, rows, cols, reinterpret_cast<char *>(tile.data()), false);
+        if (std::any_of(tile.begin(), tile.end(), [](uint8_t cell) { return cell > ALIVE_CELL; }))
+        {
+            error = INPUT_CHARACTER;
+        }
+    }
+    else
+    {
+        const int first = col / 8, count = cols > 0 ? (col + cols - 1) / 8 - first + 1 : 0;
+        std::vector<char> data(size_t(rows) * count);
+        transferRect(file, body, (globalCols + 7) / 8, row, first, rows, count, data.data(), false);
+        for (int i = 0; i < rows; i++)
+        {
+            for (int j = 0; j < cols; j++)
+            {
+                tile[size_t(i) * cols + j] = (data[size_t(i) * count + (col + j) / 8 - first] >> ((col + j) % 8)) & 1;
+            }
+        }
+    }
+
+    reportInputError(error);
+    return tile;
+}
+
+
+/**
+ * Reads the tile of this process from an RLE pattern (collective).
+ *
+ * @param file The input file.
+ * @param body Offset of the RLE body (after the header line).
+ * @param row First row of the tile.
+ * @param col First column of the tile.
+ * @param cols Columns of the tile.
+ * @param tile The cells of the tile (dead, empty if the process has no tile), the live cells are set.
+ * @brief Every process parses an equal chunk of the body: the tokens (<count><tag>) that start in it.
+ *  The position after a chunk depends on the chunks before it, so the processes exchange how far their
+ *  chunks move (rows and columns) and the live runs are then sent to the processes of their tiles.
+ */
+void GameOfLife::readRleTile(MPI_File file, MPI_Offset body, int row, int col, int cols, std::vector<uint8_t> &tile)
+{
+    MPI_Offset size;
+    MPI_File_get_size(file, &size);
+    const MPI_Offset length = std::max<MPI_Offset>(size - body, 0);
+    const MPI_Offset begin = body + length * rank / noRanks, end = body + length * (rank + 1) / noRanks;
+    // One byte before the chunk tells if a token goes on from the previous chunk
+    const MPI_Offset readBegin = std::max(begin - 1, body), readEnd = std::min(end + RLE_LOOKAHEAD, size);
+    std::vector<char> text(std::max<MPI_Offset>(readEnd - readBegin, 0));
+    MPI_File_read_at_all(file, readBegin, text.data(), text.size(), MPI_CHAR, MPI_STATUS_IGNORE);
+
+    InputError error = INPUT_OK;
+    std::vector<long long> runs;    // Live runs: row and column relative to the chunk start, length
+    long long relRow = 0, relCol = 0;
+    bool terminated = false;
+    size_t p = begin - readBegin;
+    const size_t stop = end - readBegin;
+    if (p > 0 && isdigit((unsigned char)text[p - 1]))
+    {
+        // The count and the tag of a token of the previous chunk
+        while (p < text.size() && isdigit((unsigned char)text[p]))
+        {
+            p++;
+        }
+        p++;
+    }
+    while (p < stop && !terminated && error == INPUT_OK)
+    {
+        if (isspace((unsigned char)text[p]))
+        {
+            p++;
+            continue;
+        }
+        long long count = 0;
+        bool counted = false;
+        while (p < text.size() && isdigit((unsigned char)text[p]) && count < INT32_MAX)
+        {
+            count = count * 10 + text[p++] - '0';
+            counted = true;
+        }
+        if (p >= text.size())
+        {
+            error = INPUT_RLE_TAG;
+            break;
+        }
+        count = counted ? count : 1;
+        switch (text[p++])
+        {
+        case 'b':
+            relCol += count;
+            break;
+        case 'o':
+            runs.insert(runs.end(), {relRow, relCol, count});
+            relCol += count;
+            break;
+        case '$':
+            relRow += count;
+            relCol = 0;
+            break;
+        case '!':
+            terminated = true;
+            break;
+        default:
+            error = INPUT_RLE_TAG;
+        }
+    }
+
+    // Start of the chunk: the moves of the chunks before it (anything after the end of the pattern is ignored)
+    long long move[3] = {relRow, relCol, terminated}, startRow = 0, startCol = 0;
+    std::vector<long long> moves(3 * noRanks);
+    MPI_Allgather(move, 3, MPI_LONG_LONG, moves.data(), 3, MPI_LONG_LONG, MPI_COMM_WORLD);
+    for (int k = 0; k < rank; k++)
+    {
+        if (moves[3 * k + 2])
+        {
+            runs.clear();
+            error = INPUT_OK;
+            break;
+        }
+        startCol = moves[3 * k] > 0 ? moves[3 * k + 1] : startCol + moves[3 * k + 1];
+        startRow += moves[3 * k];
+    }
+
+    // Split the runs by the tiles: row, column and length of every piece
+    std::vector<std::vector<int>> pieces(noRanks);
+    for (size_t r = 0; r < runs.size() && error == INPUT_OK; r += 3)
+    {
+        long long runRow = startRow + runs[r], runCol = (runs[r] == 0 ? startCol : 0) + runs[r + 1], runLength = runs[r + 2];
+        if (runRow >= globalRows || runCol + runLength > globalCols)
+        {
+            error = INPUT_RLE_SIZE;
+            break;
+        }
+        while (runLength > 0)
+        {
+            int colEnd, owner = tileOwner(runRow, runCol, colEnd);
+            int piece = std::min<long long>(runLength, colEnd - runCol);
+            pieces[owner].insert(pieces[owner].end(), {int(runRow), int(runCol), piece});
+            runCol += piece;
+            runLength -= piece;
+        }
+    }
+    reportInputError(error);
+
+    std::vector<int> sendCounts(noRanks), sendDispls(noRanks), recvCounts(noRanks), recvDispls(noRanks), sent;
+    for (int k = 0; k < noRanks; k++)
+    {
+        sendCounts[k] = pieces[k].size();
+        sendDispls[k] = sent.size();
+        sent.insert(sent.end(), pieces[k].begin(), pieces[k].end());
+    }
+    MPI_Alltoall(sendCounts.data(), 1, MPI_INT, recvCounts.data(), 1, MPI_INT, MPI_COMM_WORLD);
+    int received = 0;
+    for (int k = 0; k < noRanks; k++)
+    {
+        recvDispls[k] = received;
+        received += recvCounts[k];
+    }
+    std::vector<int> mine(received);
+    MPI_Alltoallv(sent.data(), sendCounts.data(), sendDispls.data(), MPI_INT,
+                  mine.data(), recvCounts.data(), recvDispls.data(), MPI_INT, MPI_COMM_WORLD);
+
+    for (int r = 0; r < received; r += 3)
+    {
+        std::fill_n(&tile[size_t(mine[r] - row) * cols + mine[r + 1] - col], mine[r + 2], ALIVE_CELL);
+    }
+}
+
+
+/**
+ * Stops the program if any process found an error in the input file (collective).
+ *
+ * @param error Error found by this process.
+ */
+void GameOfLife::reportInputError(int error) const
+{
+    static const char *messages[] = {"", "The lines are not the same length.", "The grid may only contain 0 and 1.",
+                                     "Unknown tag in the RLE pattern.", "The RLE pattern is larger than its header."};
+    MPI_Allreduce(MPI_IN_PLACE, &error, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+    if (error != INPUT_OK)
+    {
+        if (rank == 0)
+        {
+            std::cerr << "0: [Error]: " << messages[error] << std::endl;
+        }
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+}
+
+
+/**
+ * Reads or writes a rectangle of a file of rows of bytes (collective).
+ *
+ * @param file The file.
+ * @param displacement Offset of the first row in the file.
+ * @param rowSize Bytes of a row of the file.
+ * @param row First row of the rectangle.
+ * @param first First byte of the rectangle in its rows.
+ * @param rows Rows of the rectangle (0 on processes without one).
+ * @param count Bytes of the rectangle in every row.
+ * @param data The rectangle, row by row.
+ * @param write true to write the rectangle, false to read it.
+ */
+void GameOfLife::transferRect(MPI_File file, MPI_Offset displacement, int rowSize, int row, int first, int rows, int count,
+                              char *data, bool write) const
+{
+    MPI_Datatype view = MPI_BYTE;
+    const bool owned = rows > 0 && count > 0;
+    if (owned)
+    {
+        int sizes[N_DIMS] = {globalRows, rowSize}, subsizes[N_DIMS] = {rows, count}, starts[N_DIMS] = {row, first};
+        MPI_Type_create_subarray(N_DIMS, sizes, subsizes, starts, MPI_ORDER_C, MPI_BYTE, &view);
+        MPI_Type_commit(&view);
+    }
+
+    MPI_File_set_view(file, displacement, MPI_BYTE, view, "native", MPI_INFO_NULL);
+    const int bytes = owned ? rows * count : 0;
+    if (write)
+    {
+        MPI_File_write_all(file, data, bytes, MPI_BYTE, MPI_STATUS_IGNORE);
+    }
+    else
+    {
+        MPI_File_read_all(file, data, bytes, MPI_BYTE, MPI_STATUS_IGNORE);
+    }
+
+    if (owned)
+    {
+        MPI_Type_free(&view);
+    }
+}
+
+
+/**
+ * Returns the process that holds a cell.
+ *
+ * @param row Row of the cell.
+ * @param col Column of the cell.
+ * @param colEnd Column after the tile of the cell.
+ * @return Rank of the process (the first process for HashLife).
+ */
+int GameOfLife::tileOwner(int row, int col, int &colEnd) const
+{
+    if (engine == ENGINE_HASHLIFE)
+    {
+        colEnd = globalCols;
+        return 0;
+    }
+
+    // The part of the tile grid with the position (the parts are within one of an even split)
+    auto part = [](int position, int size, int parts)
+    {
+        int index = (long long)position * parts / size;
+        while (index + 1 < parts && (long long)size * (index + 1) / parts <= position)
+        {
+            index++;
+        }
+        while ((long long)size * index / parts > position)
+        {
+            index--;
+        }
+        return index;
+    };
+    int tileCoords[N_DIMS] = {part(row, globalRows, dims[0]), part(col, globalCols, dims[1])}, tileRow, tileCol, rows, cols;
+    tileExtent(tileCoords, tileRow, tileCol, rows, cols);
+    colEnd = tileCol + cols;
+    // The Cartesian communicator keeps the ranks (row-major order of the tiles)
+    return tileCoords[0] * dims[1] + tileCoords[1];
+}
+
+
+/**
+ * Gathers the tiles of a row of tiles on its first process (collective).
+ *
+ * @param tile The tile of this process.
+ * @param rows Rows of the tile (0 if the process has no tile).
+ * @param bandRow First row of the band.
+ * @param bandRows Rows of the band (0 on the other processes).
+ * @return The whole rows of the band on the first process of the row of tiles, nothing on the others.
+ */
+std::vector<uint8_t> GameOfLife::gatherBand(const std::vector<uint8_t> &tile, int rows, int &bandRow, int &bandRows) const
+{
+    bandRow = bandRows = 0;
+    if (engine == ENGINE_HASHLIFE || cartComm == MPI_COMM_NULL)
+    {
+        bandRows = rank == 0 ? rows : 0;
+        return bandRows > 0 ? tile : std::vector<uint8_t>();
+    }
+
+    MPI_Comm bandComm;
+    MPI_Comm_split(cartComm, coords[0], coords[1], &bandComm);
+    std::vector<int> counts(dims[1]), displs(dims[1]), firstCols(dims[1]);
+    for (int c = 0, total = 0; c < dims[1]; c++)
+    {
+        int tileCoords[N_DIMS] = {coords[0], c}, tileRow, tileRows, tileCols;
+        tileExtent(tileCoords, tileRow, firstCols[c], tileRows, tileCols);
+        counts[c] = tileRows * tileCols;
+        displs[c] = total;
+        total += counts[c];
+    }
+
+    std::vector<uint8_t> gathered(coords[1] == 0 ? size_t(localRows) * globalCols : 0), band(gathered.size());
+    MPI_Gatherv(tile.data(), tile.size(), MPI_UINT8_T, gathered.data(), counts.data(), displs.data(), MPI_UINT8_T, 0, bandComm);
+    MPI_Comm_free(&bandComm);
+    if (coords[1] != 0)
+    {
+        return std::vector<uint8_t>();
+    }
+
+    for (int c = 0; c < dims[1]; c++)
+    {
+        int tileCols = counts[c] / localRows;
+        for (int i = 0; i < localRows; i++)
+        {
+            std::copy_n(&gathered[displs[c] + size_t(i) * tileCols], tileCols, &band[size_t(i) * globalCols + firstCols[c]]);
+        }
+    }
+    bandRow = firstRow;
+    bandRows = localRows;
+    return band;
+}
+
+
+/**
+ * Writes the grid into the output file (collective).
+ *
+ * @param tile The tile of this process, row by row.
+ * @param row First row of the tile.
+ * @param col First column of the tile.
+ * @param rows Rows of the tile (0 if the process has no tile).
+ * @param cols Columns of the tile.
+ * @brief Text tiles are written through a subarray view. The rows of the binary and RLE formats are not
+ *  split at the tile edges (bytes, runs), so every row of tiles is gathered on its first process, which
+ *  writes it at the offset of the band (the RLE offsets are the sizes of the bands before it).
+ */
+void GameOfLife::writeOutputFile(const std::vector<uint8_t> &tile, int row, int col, int rows, int cols)
+{
+    GridFormat format = gridFormat(outputPath);
+    MPI_File file;
+    if (MPI_File_open(MPI_COMM_WORLD, outputPath.c_str(), MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &file) != MPI_SUCCESS)
+    {
+        // All processes fail, the first one reports it
+        if (rank == 0)
+        {
+            std::cerr << "Failed to open output file." << std::endl;
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+    }
+
+    if (format == FORMAT_TEXT)
+    {
+        MPI_File_set_size(file, (MPI_Offset)globalRows * (globalCols + 1));
+        const int eol = col + cols == globalCols ? 1 : 0, count = cols + eol;
+        std::vector<char> data(size_t(rows) * count, '\n');
+        for (int i = 0; i < rows; i++)
+        {
+            for (int j = 0; j < cols; j++)
+            {
+                data[size_t(i) * count + j] = '0' + tile[size_t(i) * cols + j];
+            }
+        }
+        transferRect(file, 0, globalCols + 1, row, col, rows, count, data.data(), true);
+        MPI_File_close(&file);
+        return;
+    }
+
+    int bandRow, bandRows;
+    std::vector<uint8_t> band = gatherBand(tile, rows, bandRow, bandRows);
+    std::string data;
+    MPI_Offset offset = 0;
+    if (format == FORMAT_BINARY)
+    {
+        const int rowBytes = (globalCols + 7) / 8;
+        data.assign(size_t(bandRows) * rowBytes, 0);
+        for (int i = 0; i < bandRows; i++)
+        {
+            for (int j = 0; j < globalCols; j++)
+            {
+                data[size_t(i) * rowBytes + j / 8] |= band[size_t(i) * globalCols + j] << (j % 8);
+            }
+        }
+        offset = BINARY_HEADER_SIZE + (MPI_Offset)bandRow * rowBytes;
+        MPI_File_set_size(file, BINARY_HEADER_SIZE + (MPI_Offset)globalRows * rowBytes);
+        if (rank == 0)
+        {
+            char header[BINARY_HEADER_SIZE] = {};
+            uint32_t size32[2] = {uint32_t(globalRows), uint32_t(globalCols)};
+            memcpy(header, BINARY_MAGIC, strlen(BINARY_MAGIC));
+            memcpy(header + strlen(BINARY_MAGIC), size32, sizeof(size32));
+            MPI_File_write_at(file, 0, header, BINARY_HEADER_SIZE, MPI_CHAR, MPI_STATUS_IGNORE);
+        }
+    }
+    else
+    {
+        // Runs of every row without the dead cells at its end, the ends of rows are merged ("3$"),
+        // every band starts on a new line
+        if (rank == 0)
+        {
+            data = "x = " + std::to_string(globalCols) + ", y = " + std::to_string(globalRows) + ", rule = " + ruleName(rule) + "\n";
+        }
+        size_t lineStart = data.size();
+        auto token = [&](long long count, char tag)
+        {
+            std::string text = (count > 1 ? std::to_string(count) : "") + tag;
+            if (data.size() - lineStart + text.size() > RLE_LINE_LENGTH)
+            {
+                data += '\n';
+                lineStart = data.size();
+            }
+            data += text;
+        };
+        long long rowEnds = 0;
+        for (int i = 0; i < bandRows; i++)
+        {
+            const uint8_t *cells = &band[size_t(i) * globalCols];
+            for (int j = 0; j < globalCols;)
+            {
+                int runEnd = j;
+                while (runEnd < globalCols && cells[runEnd] == cells[j])
+                {
+                    runEnd++;
+                }
+                if (runEnd == globalCols && cells[j] == DEAD_CELL)
+                {
+                    break;
+                }
+                if (rowEnds > 0)
+                {
+                    token(rowEnds, '$');
+                    rowEnds = 0;
+                }
+                token(runEnd - j, cells[j] == ALIVE_CELL ? 'o' : 'b');
+                j = runEnd;
+            }
+            rowEnds++;
+        }
+        if (bandRows > 0)
+        {
+            if (bandRow + bandRows == globalRows)
+            {
+                token(1, '!');
+            }
+            else
+            {
+                token(rowEnds, '$');
+            }
+            data += '\n';
+        }
+
+        long long bytes = data.size(), before = 0, total = 0;
+        MPI_Exscan(&bytes, &before, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+        MPI_Allreduce(&bytes, &total, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+        offset = rank == 0 ? 0 : before;
+        MPI_File_set_size(file, total);
+    }
+
+    MPI_File_write_at_all(file, offset, data.data(), data.size(), MPI_CHAR, MPI_STATUS_IGNORE);
+    MPI_File_close(&file);
+}
+
+
+/**
+ * Opens the checkpoint file for a restart (collective).
+ *
+ * @param file The checkpoint file (open if there is a complete checkpoint).
+ * @param body Offset of the cells of the latest complete checkpoint.
+ * @return true if there is a complete checkpoint.
+ * @brief The first process picks the slot with the latest generation. Sets the size of the grid,
+ *  the generation the run starts at, the slot of the next checkpoint and the rule (a rule given
+ *  by -b has to be the rule of the checkpoint).
+ */
+bool GameOfLife::findCheckpoint(MPI_File &file, MPI_Offset &body)
+{
+    if (MPI_File_open(MPI_COMM_WORLD, checkpointPath.c_str(), MPI_MODE_RDONLY, MPI_INFO_NULL, &file) != MPI_SUCCESS)
+    {
+        return false;
+    }
+
+    // Rows, columns, slot (-1 for none) and generation of the latest complete checkpoint, birth and survival masks
+    long long latest[6] = {0, 0, -1, -1, 0, 0};
+    if (rank == 0)
+    {
+        MPI_Offset size;
+        MPI_File_get_size(file, &size);
+        char header[CHECKPOINT_HEADER_SIZE];
+        uint32_t size32[2];
+        int64_t times[CHECKPOINT_SLOTS];
+        uint16_t masks[2];
+        if (size >= CHECKPOINT_HEADER_SIZE)
+        {
+            MPI_File_read_at(file, 0, header, CHECKPOINT_HEADER_SIZE, MPI_CHAR, MPI_STATUS_IGNORE);
+            memcpy(size32, header + strlen(CHECKPOINT_MAGIC), sizeof(size32));
+            memcpy(times, header + 16, sizeof(times));
+            memcpy(masks, header + CHECKPOINT_RULE, sizeof(masks));
+            latest[0] = size32[0];
+            latest[1] = size32[1];
+            latest[4] = masks[0];
+            latest[5] = masks[1];
+        }
+        const long long cells = latest[0] * latest[1];
+        for (int slot = 0; slot < CHECKPOINT_SLOTS && memcmp(header, CHECKPOINT_MAGIC, strlen(CHECKPOINT_MAGIC)) == 0; slot++)
+        {
+            if (times[slot] > latest[3] && cells > 0 && size >= CHECKPOINT_HEADER_SIZE + (slot + 1) * cells)
+            {
+                latest[2] = slot;
+                latest[3] = times[slot];
+            }
+        }
+        if (latest[3] > gameTime)
+        {
+            std::cerr << "0: [Error]: The checkpoint is after the game time." << std::endl;
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        const Rule checkpointRule{uint16_t(latest[4]), uint16_t(latest[5])};
+        if (latest[2] >= 0 && ruleGiven && !(checkpointRule == rule))
+        {
+            std::cerr << "0: [Error]: The checkpoint was computed with the rule " << ruleName(checkpointRule)
+                      << ", not " << ruleName(rule) << "." << std::endl;
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+    MPI_Bcast(latest, 6, MPI_LONG_LONG, 0, MPI_COMM_WORLD);
+    if (latest[2] < 0)
+    {
+        MPI_File_close(&file);
+        return false;
+    }
+
+    globalRows = latest[0];
+    globalCols = latest[1];
+    body = CHECKPOINT_HEADER_SIZE + latest[2] * globalRows * globalCols;
+    startTime = latest[3];
+    checkpointSlot = (latest[2] + 1) % CHECKPOINT_SLOTS;
+    setRule(Rule{uint16_t(latest[4]), uint16_t(latest[5])});
+    return true;
+}
+
+
+/**
+ * Opens the checkpoint file for writing (collective over the tiles).
+ *
+ * @brief A new run creates the file with no complete slot, a restart keeps the checkpoint it started from.
+ */
+void GameOfLife::openCheckpoint()
+{
+    if (MPI_File_open(cartComm, checkpointPath.c_str(), MPI_MODE_CREATE | MPI_MODE_RDWR, MPI_INFO_NULL, &checkpointFile) != MPI_SUCCESS)
+    {
+        if (rank == 0)
+        {
+            std::cerr << "Failed to open checkpoint file." << std::endl;
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        MPI_Barrier(cartComm);
+    }
+    if (startTime > 0)
+    {
+        return;
+    }
+
+    MPI_File_set_size(checkpointFile, CHECKPOINT_HEADER_SIZE + (MPI_Offset)CHECKPOINT_SLOTS * globalRows * globalCols);
+    if (rank == 0)
+    {
+        char header[CHECKPOINT_HEADER_SIZE];
+        uint32_t size32[2] = {uint32_t(globalRows), uint32_t(globalCols)};
+        int64_t times[CHECKPOINT_SLOTS];
+        uint16_t masks[2] = {rule.birth, rule.survival};
+        std::fill_n(times, CHECKPOINT_SLOTS, -1);
+        memcpy(header, CHECKPOINT_MAGIC, strlen(CHECKPOINT_MAGIC));
+        memcpy(header + strlen(CHECKPOINT_MAGIC), size32, sizeof(size32));
+        memcpy(header + 16, times, sizeof(times));
+        memcpy(header + CHECKPOINT_RULE, masks, sizeof(masks));
+        MPI_File_write_at(checkpointFile, 0, header, CHECKPOINT_HEADER_SIZE, MPI_CHAR, MPI_STATUS_IGNORE);
+    }
+    MPI_File_sync(checkpointFile);
+}
+
+
+/**
+ * Starts writing a checkpoint if one is due (main thread, collective over the tiles).
+ *
+ * @param time Generation of the grid in currGrid (or currBits).
+ * @brief Completes the previous checkpoint, marks the next slot incomplete and starts a
+ *  non-blocking collective write of a copy of the tile into it. The tile is copied before
+ *  the grids change, the other threads only read currGrid meanwhile.
+ */
+void GameOfLife::startCheckpoint(long long time)
+{
+    if (checkpointInterval == 0 || time == startTime || time % checkpointInterval != 0)
+    {
+        return;
+    }
+    finishCheckpoint();
+
+    // The slot is marked incomplete (on the disk) before its cells are overwritten
+    if (rank == 0)
+    {
+        int64_t incomplete = -1;
+        MPI_File_write_at(checkpointFile, 16 + 8 * checkpointSlot, &incomplete, 1, MPI_INT64_T, MPI_STATUS_IGNORE);
+    }
+    MPI_File_sync(checkpointFile);
+
+    checkpointTile = getTile();
+    int sizes[N_DIMS] = {globalRows, globalCols}, subsizes[N_DIMS] = {localRows, localCols}, starts[N_DIMS] = {firstRow, firstCol};
+    MPI_Datatype view;
+    MPI_Type_create_subarray(N_DIMS, sizes, subsizes, starts, MPI_ORDER_C, MPI_UINT8_T, &view);
+    MPI_Type_commit(&view);
+    MPI_File_set_view(checkpointFile, CHECKPOINT_HEADER_SIZE + (MPI_Offset)checkpointSlot * globalRows * globalCols,
+                      MPI_UINT8_T, view, "native", MPI_INFO_NULL);
+    MPI_Type_free(&view);
+    MPI_File_iwrite_all(checkpointFile, checkpointTile.data(), checkpointTile.size(), MPI_UINT8_T, &checkpointRequest);
+    checkpointTime = time;
+}
+
+
+/**
+ * Lets the checkpoint being written progress (main thread).
+ */
+void GameOfLife::progressCheckpoint()
+{
+    if (checkpointRequest != MPI_REQUEST_NULL)
+    {
+        int done;
+        MPI_Test(&checkpointRequest, &done, MPI_STATUS_IGNORE);
+    }
+}
+
+
+/**
+ * Completes the checkpoint being written (main thread, collective over the tiles).
+ *
+ * @brief Waits for the write, flushes the cells of all processes to the disk and only then
+ *  marks the slot complete with its generation.
+ */
+void GameOfLife::finishCheckpoint()
+{
+    if (checkpointTime < 0)
+    {
+        return;
+    }
+
+    MPI_Wait(&checkpointRequest, MPI_STATUS_IGNORE);
+    // The offsets of the header are in bytes from the start of the file again
+    MPI_File_set_view(checkpointFile, 0, MPI_BYTE, MPI_BYTE, "native", MPI_INFO_NULL);
+    MPI_File_sync(checkpointFile);
+    MPI_Barrier(cartComm);
+    if (rank == 0)
+    {
+        int64_t time = checkpointTime;
+        MPI_File_write_at(checkpointFile, 16 + 8 * checkpointSlot, &time, 1, MPI_INT64_T, MPI_STATUS_IGNORE);
+    }
+    MPI_File_sync(checkpointFile);
+
+    checkpointSlot = (checkpointSlot + 1) % CHECKPOINT_SLOTS;
+    checkpointTime = -1;
+    std::vector<uint8_t>().swap(checkpointTile);
+}
+
+
+/**
+ * Completes the last checkpoint and closes the checkpoint file (collective over the tiles).
+ */
+void GameOfLife::closeCheckpoint()
+{
+    if (checkpointFile != MPI_FILE_NULL)
+    {
+        finishCheckpoint();
+        MPI_File_close(&checkpointFile);
+    }
+}
+
+
+/**
+ * Creates the Cartesian process grid and the tile of this process.
+ *
+ * @brief Picks the largest number of processes whose 2D grid (from MPI_Dims_create) fits into
+ *  the cell grid, so every tile has at least one row and one column. The larger dimension of
+ *  the process grid goes to the larger dimension of the cell grid. The processes that do not
+ *  fit get MPI_COMM_NULL and stay idle.
+ */
+void GameOfLife::createDecomposition()
+{
+    int active = std::min<long long>(maxRanks > 0 ? std::min(maxRanks, noRanks) : noRanks, (long long)globalRows * globalCols);
+    for (;; active--)
+    {
+        dims[0] = dims[1] = 0;
+        MPI_Dims_create(active, N_DIMS, dims);
+        if (globalRows < globalCols)
+        {
+            std::swap(dims[0], dims[1]);
+        }
+        if (layout == LAYOUT_ROWS)
+        {
+            dims[0] = active;
+            dims[1] = 1;
+        }
+        if (dims[0] <= globalRows && dims[1] <= globalCols)
+        {
+            break;
+        }
+    }
+
+    // Torus in both directions, no reordering so the active processes keep their ranks
+    MPI_Comm activeComm;
+    MPI_Comm_split(MPI_COMM_WORLD, rank < active ? 0 : MPI_UNDEFINED, rank, &activeComm);
+    if (activeComm == MPI_COMM_NULL)
+    {
+        return;
+    }
+
+    int periods[N_DIMS] = {1, 1};
+    MPI_Cart_create(activeComm, N_DIMS, dims, periods, 0, &cartComm);
+    MPI_Comm_free(&activeComm);
+
+    MPI_Cart_coords(cartComm, rank, N_DIMS, coords);
+    MPI_Cart_shift(cartComm, 0, 1, &north, &south);
+    MPI_Cart_shift(cartComm, 1, 1, &west, &east);
+
+    // Diagonal neighbours (out of range coordinates wrap around in the periodic grid)
+    int diagonal[N_DIMS] = {coords[0] - 1, coords[1] - 1};
+    MPI_Cart_rank(cartComm, diagonal, &northWest);
+    diagonal[1] = coords[1] + 1;
+    MPI_Cart_rank(cartComm, diagonal, &northEast);
+    diagonal[0] = coords[0] + 1;
+    MPI_Cart_rank(cartComm, diagonal, &southEast);
+    diagonal[1] = coords[1] - 1;
+    MPI_Cart_rank(cartComm, diagonal, &southWest);
+    tileExtent(coords, firstRow, firstCol, localRows, localCols);
+}
+
+
+/**
+ * Computes the part of the grid that belongs to the tile at the given coordinates.
+ *
+ * @param tileCoords Coordinates of the tile in the process grid.
+ * @param row First row of the tile.
+ * @param col First column of the tile.
+ * @param rows Number of rows of the tile.
+ * @param cols Number of columns of the tile.
+ * @brief The rows and columns are split as evenly as possible (the sizes differ by at most one).
+ */
+void GameOfLife::tileExtent(const int tileCoords[N_DIMS], int &row, int &col, int &rows, int &cols) const
+{
+    row = (long long)globalRows * tileCoords[0] / dims[0];
+    col = (long long)globalCols * tileCoords[1] / dims[1];
+    rows = (long long)globalRows * (tileCoords[0] + 1) / dims[0] - row;
+    cols = (long long)globalCols * (tileCoords[1] + 1) / dims[1] - col;
+}
+
+
+/**
+ * Allocates the byte grids of the tile.
+ *
+ * @brief Both grids are zeroed (all cells dead), the rows are padded by two of the widest vectors,
+ *  so the vector kernels may read and write past the last column without bounds checks.
+ *  Every thread zeroes the rows of its band, so they are placed on its NUMA node.
+ */
+void GameOfLife::allocateGrids()
+{
+    stride = (localCols + 2 * ghostWidth + 2 * MAX_VECTOR + GRID_ALIGNMENT - 1) / GRID_ALIGNMENT * GRID_ALIGNMENT;
+    uint8_t *grids[2];
+    for (int b = 0; b < 2; b++)
+    {
+        // Not initialized here, the pages are touched first by the threads
+        gridBuffers[b].reset(new uint8_t[stride * (localRows + 2 * ghostWidth) + GRID_ALIGNMENT]);
+        uintptr_t address = reinterpret_cast<uintptr_t>(gridBuffers[b].get());
+        grids[b] = gridBuffers[b].get() + (GRID_ALIGNMENT - address % GRID_ALIGNMENT) % GRID_ALIGNMENT;
+    }
+    currGrid = grids[0];
+    nextGrid = grids[1];
+
+    rowSums.resize(noThreads);
+    runThreads([&](int thread)
+    {
+        int first = std::max(bandBegin(thread), -ghostWidth), end = std::min(bandEnd(thread), localRows + ghostWidth);
+        for (int i = first; i < end; i++)
+        {
+            std::fill_n(cellAt(currGrid, i, -ghostWidth), stride, DEAD_CELL);
+            std::fill_n(cellAt(nextGrid, i, -ghostWidth), stride, DEAD_CELL);
+        }
+        rowSums[thread].assign(stride, 0);
+    });
+}
+
+
+/**
+ * Returns the address of a cell of a byte grid.
+ *
+ * @param grid The grid.
+ * @param row Row in the tile (negative and >= localRows are ghost rows).
+ * @param col Column in the tile (negative and >= localCols are ghost columns).
+ * @return Address of the cell.
+ */
+uint8_t *GameOfLife::cellAt(uint8_t *grid, int row, int col) const
+{
+    return grid + (row + ghostWidth) * stride + col + ghostWidth;
+}
+
+
+/**
+ * Returns the cells of the tile.
+ *
+ * @return The cells of currGrid (currBits while the bits kernel runs) without the ghost cells, row by row.
+ */
+std::vector<uint8_t> GameOfLife::getTile() const
+{
+    std::vector<uint8_t> tile(size_t(localRows) * localCols);
+    for (int i = 0; i < localRows; i++)
+    {
+        if (!currBits.empty())
+        {
+            const uint64_t *row = &currBits[size_t(i + 1) * rowWords];
+            for (int j = 0; j < localCols; j++)
+            {
+                tile[size_t(i) * localCols + j] = (row[(j + 1) / WORD_BITS] >> ((j + 1) % WORD_BITS)) & 1;
+            }
+            continue;
+        }
+        const uint8_t *row = cellAt(currGrid, i, 0);
+        std::copy(row, row + localCols, tile.begin() + size_t(i) * localCols);
+    }
+    return tile;
+}
+
+
+/**
+ * Sets the cells of the tile.
+ *
+ * @param tile The cells of the tile without the ghost cells, row by row.
+ * @brief Copies the cells into currGrid.
+ */
+void GameOfLife::setTile(const uint8_t *tile)
+{
+    for (int i = 0; i < localRows; i++)
+    {
+        std::copy(tile + size_t(i) * localCols, tile + size_t(i + 1) * localCols, cellAt(currGrid, i, 0));
+    }
+}
+
+
+/**
+ * Hashes a word of the grid (NH: the product of its halves with added keys).
+ *
+ * @param word The word (8 byte cells or 64 bit cells).
+ * @param key Key of the position of the word in its row.
+ * @return The hash, the hashes of the words of a row are summed.
+ */
+static inline uint64_t hashWord(uint64_t word, uint32_t key)
+{
+    return uint64_t(uint32_t(word) + key) * (uint32_t(word >> 32) + (key ^ HASH_KEY_FLIP));
+}
+
+
+/**
+ * Mixes the hash of a row with its position.
+ *
+ * @param hash Sum of the hashes of the words of the row.
+ * @param position Position of the first cell of the row in the whole grid.
+ * @return The hash of the row, the hashes of the rows are summed (in any order).
+ */
+static inline uint64_t hashRow(uint64_t hash, uint64_t position)
+{
+    hash = (hash ^ position * HASH_POSITION) * HASH_MULTIPLIER;
+    hash ^= hash >> 29;
+    return hash * HASH_POSITION;
+}
+
+
+/**
+ * Hashes the rows of the band of a thread.
+ *
+ * @param thread The thread.
+ * @return Sum of the hashes of the rows (at their positions in the whole grid).
+ * @brief The words take one 32-bit multiplication each and are independent, so the sum of a
+ *  tile does not depend on the split into bands and the loop is vectorized. Equal grids always
+ *  have equal hashes, a collision only costs a failed verification.
+ */
+uint64_t GameOfLife::hashBand(int thread) const
+{
+    uint64_t hash = 0;
+    for (int i = localRows * thread / noThreads; i < localRows * (thread + 1) / noThreads; i++)
+    {
+        uint64_t rowHash = 0;
+        if (!currBits.empty())
+        {
+            const uint64_t *row = &currBits[size_t(i + 1) * rowWords];
+            for (int w = 0; w < rowWords; w++)
+            {
+                rowHash += hashWord(row[w] & interiorMask[w], uint32_t(w) * HASH_KEY);
+            }
+        }
+        else
+        {
+            const uint8_t *row = cellAt(currGrid, i, 0);
+            int j = 0;
+            for (; j + 8 <= localCols; j += 8)
+            {
+                uint64_t word;
+                memcpy(&word, row + j, sizeof(word));
+                rowHash += hashWord(word, uint32_t(j) * HASH_KEY);
+            }
+            uint64_t word = 0;
+            memcpy(&word, row + j, localCols - j);
+            rowHash += hashWord(word, uint32_t(j) * HASH_KEY);
+        }
+        hash += hashRow(rowHash, uint64_t(firstRow + i) * globalCols + firstCol);
+    }
+    return hash;
+}
+
+
+/**
+ * Samples the grid for the cycle detection (all threads, after a generation).
+ *
+ * @param thread The thread.
+ * @param time Generation of the grid in currGrid (or currBits).
+ * @return Generation to continue at (later than time if whole periods are skipped).
+ */
+long long GameOfLife::detectCycle(int thread, long long time)
+{
+    if (cyclePeriods == 0)
+    {
+        return time;
+    }
+
+    threadHashes[thread] = hashBand(thread);
+    threadBarrier->wait();
+    if (thread == 0)
+    {
+        checkCycle(time);
+    }
+    threadBarrier->wait();
+    return resumeTime;
+}
+
+
+/**
+ * Compares the hash of the grid with the last samples (main thread, collective over the tiles).
+ *
+ * @param time Generation of the grid in currGrid (or currBits).
+ * @brief A repeated hash starts the verification: the tile is kept and compared with the tile
+ *  after the period. If all tiles are equal, the grid repeats with the period and the whole periods
+ *  left are skipped (resumeTime), the detection stops. Otherwise the hash was a collision, and the next
+ *  repeated hash is verified. Only the periods that end at a sampled generation are verified.
+ */
+void GameOfLife::checkCycle(long long time)
+{
+    resumeTime = time;
+    uint64_t hash = 0;
+    for (uint64_t threadHash : threadHashes)
+    {
+        hash += threadHash;
+    }
+    MPI_Allreduce(MPI_IN_PLACE, &hash, 1, MPI_UINT64_T, MPI_SUM, cartComm);
+
+    if (verifyTime >= 0 && time >= verifyTime + verifyPeriod)
+    {
+        if (time == verifyTime + verifyPeriod)
+        {
+            int same = getTile() == verifyTile;
+            MPI_Allreduce(MPI_IN_PLACE, &same, 1, MPI_INT, MPI_LAND, cartComm);
+            if (same)
+            {
+                resumeTime = time + (gameTime - time) / verifyPeriod * verifyPeriod;
+                if (rank == 0)
+                {
+                    std::cerr << "Cycle of period " << verifyPeriod << " from generation " << verifyTime
+                              << ", skipped " << resumeTime - time << " generations." << std::endl;
+                }
+                cyclePeriods = 0;
+                return;
+            }
+        }
+        verifyTime = -1;
+    }
+
+    if (verifyTime < 0)
+    {
+        // The latest sample with the hash gives the shortest period. The samples are uneven if checkpoints
+        // (-s) clip the steps of wide ghost zones, so a period is only taken if its end is sampled
+        for (auto sample = cycleHistory.rbegin(); sample != cycleHistory.rend(); ++sample)
+        {
+            if (sample->first == hash && sampledAt(2 * time - sample->second))
+            {
+                verifyTime = time;
+                verifyPeriod = time - sample->second;
+                verifyTile = getTile();
+                break;
+            }
+        }
+    }
+    cycleHistory.emplace_back(hash, time);
+    if (int(cycleHistory.size()) > cyclePeriods)
+    {
+        cycleHistory.pop_front();
+    }
+}
+
+
+/**
+ * Checks whether the grid is sampled for the cycle detection at a generation.
+ *
+ * @param time The generation (after startTime).
+ * @return true if a step of the simulation ends at the generation.
+ * @brief The steps of ghostWidth generations start at startTime and are clipped at every checkpoint
+ *  (a multiple of checkpointInterval), after which they start again.
+ */
+bool GameOfLife::sampledAt(long long time) const
+{
+    long long cycleStart = startTime;
+    if (checkpointInterval > 0)
+    {
+        if (time % checkpointInterval == 0)
+        {
+            return true;
+        }
+        cycleStart = std::max(cycleStart, time - time % checkpointInterval);
+    }
+    return (time - cycleStart) % ghostWidth == 0;
+}
+
+
+/**
+ * Picks the ghost width (-g auto).
+ *
+ * @brief Measures one halo exchange and one generation of the tile with the current grids (ghost width 1,
+ *  the cells are not changed) and models the time per generation of the width g as
+ *  (exchange + cell time * cells computed in the g generations) / g, where the generation s of a cycle
+ *  computes (rows + 2 (g - s)) x (cols + 2 (g - s)) cells. The slowest process and the largest tile
+ *  decide, the width is limited by the smallest tile (a halo strip must come from the interior of the neighbour).
+ *  All processes pick the same width, and the grids are allocated again with it.
+ */
+void GameOfLife::tuneGhostWidth()
+{
+    createHaloRequests();
+    MPI_Barrier(cartComm);
+    double start = MPI_Wtime();
+    for (int round = 0; round < TUNE_ROUNDS; round++)
+    {
+        startHaloExchange();
+        finishHaloExchange();
+    }
+    double measured[4] = {(MPI_Wtime() - start) / TUNE_ROUNDS, 0, double(localRows), double(localCols)};
+
+    start = MPI_Wtime();
+    for (int round = 0; round < TUNE_ROUNDS; round++)
+    {
+        runThreads([&](int thread) { calculateRegion(thread, 0, localRows, localCols); });
+    }
+    measured[1] = (MPI_Wtime() - start) / TUNE_ROUNDS / (double(localRows) * localCols);
+    freeHaloRequests();
+
+    int widthLimit = std::min({localRows, localCols, MAX_GHOST_WIDTH});
+    MPI_Allreduce(MPI_IN_PLACE, measured, 4, MPI_DOUBLE, MPI_MAX, cartComm);
+    MPI_Allreduce(MPI_IN_PLACE, &widthLimit, 1, MPI_INT, MPI_MIN, cartComm);
+
+    int best = 1;
+    double bestTime = 0;
+    for (int width = 1; width <= widthLimit; width++)
+    {
+        double cells = 0;
+        for (int step = 1; step <= width; step++)
+        {
+            cells += (measured[2] + 2 * (width - step)) * (measured[3] + 2 * (width - step));
+        }
+        double time = (measured[0] + measured[1] * cells) / width;
+        if (width == 1 || time < bestTime)
+        {
+            best = width;
+            bestTime = time;
+        }
+    }
+
+    if (rank == 0)
+    {
+        std::cerr << "Ghost width: " << best << " (exchange " << measured[0] * 1e6 << " us, cell "
+                  << measured[1] * 1e9 << " ns)" << std::endl;
+    }
+
+    if (best != ghostWidth)
+    {
+        std::vector<uint8_t> tile = getTile();
+        ghostWidth = best;
+        allocateGrids();
+        setTile(tile.data());
+    }
+}
+
+
+/**
+ * Creates the persistent halo requests of both grids.
+ * 
+ * @brief Every exchange sends 8 messages to the 8 neighbours: ghostWidth rows and columns from the
+ *  edges of the tile and the ghostWidth x ghostWidth blocks in its corners (strided datatypes, no copies).
+ *  The rows and corners are received in place into the ghost zone, the columns into westColumn and
+ *  eastColumn, because the ghost columns are read by the rows computed during the exchange (and the
+ *  values are fixed afterwards, see calculateBoundary). The requests of one grid are only used while
+ *  it is currGrid, the grids are swapped by pointers. With active blocks every send also has an
+ *  empty variant, sent instead when the halo has not changed.
+ */
+void GameOfLife::createHaloRequests()
+{
+    const int g = ghostWidth;
+    westColumn.assign(size_t(localRows) * g, DEAD_CELL);
+    eastColumn.assign(size_t(localRows) * g, DEAD_CELL);
+
+    MPI_Type_vector(g, localCols, stride, MPI_UINT8_T, &rowType);
+    MPI_Type_vector(localRows, g, stride, MPI_UINT8_T, &columnType);
+    MPI_Type_vector(g, g, stride, MPI_UINT8_T, &cornerType);
+    MPI_Type_commit(&rowType);
+    MPI_Type_commit(&columnType);
+    MPI_Type_commit(&cornerType);
+
+    uint8_t *grids[2] = {currGrid, nextGrid};
+    for (int set = 0; set < 2; set++)
+    {
+        uint8_t *grid = grids[set];
+        MPI_Request *requests = haloRequests[set];
+
+        // Receives: the tag is the direction the message travels in
+        MPI_Recv_init(cellAt(grid, -g, 0), 1, rowType, north, TAG_SOUTH, cartComm, &requests[0]);
+        MPI_Recv_init(cellAt(grid, localRows, 0), 1, rowType, south, TAG_NORTH, cartComm, &requests[1]);
+        MPI_Recv_init(westColumn.data(), westColumn.size(), MPI_UINT8_T, west, TAG_EAST, cartComm, &requests[2]);
+        MPI_Recv_init(eastColumn.data(), eastColumn.size(), MPI_UINT8_T, east, TAG_WEST, cartComm, &requests[3]);
+        MPI_Recv_init(cellAt(grid, -g, -g), 1, cornerType, northWest, TAG_SOUTH_EAST, cartComm, &requests[4]);
+        MPI_Recv_init(cellAt(grid, -g, localCols), 1, cornerType, northEast, TAG_SOUTH_WEST, cartComm, &requests[5]);
+        MPI_Recv_init(cellAt(grid, localRows, -g), 1, cornerType, southWest, TAG_NORTH_EAST, cartComm, &requests[6]);
+        MPI_Recv_init(cellAt(grid, localRows, localCols), 1, cornerType, southEast, TAG_NORTH_WEST, cartComm, &requests[7]);
+
+        // Sends
+        MPI_Send_init(cellAt(grid, 0, 0), 1, rowType, north, TAG_NORTH, cartComm, &requests[8]);
+        MPI_Send_init(cellAt(grid, localRows - g, 0), 1, rowType, south, TAG_SOUTH, cartComm, &requests[9]);
+        MPI_Send_init(cellAt(grid, 0, 0), 1, columnType, west, TAG_WEST, cartComm, &requests[10]);
+        MPI_Send_init(cellAt(grid, 0, localCols - g), 1, columnType, east, TAG_EAST, cartComm, &requests[11]);
+        MPI_Send_init(cellAt(grid, 0, 0), 1, cornerType, northWest, TAG_NORTH_WEST, cartComm, &requests[12]);
+        MPI_Send_init(cellAt(grid, 0, localCols - g), 1, cornerType, northEast, TAG_NORTH_EAST, cartComm, &requests[13]);
+        MPI_Send_init(cellAt(grid, localRows - g, 0), 1, cornerType, southWest, TAG_SOUTH_WEST, cartComm, &requests[14]);
+        MPI_Send_init(cellAt(grid, localRows - g, localCols - g), 1, cornerType, southEast, TAG_SOUTH_EAST, cartComm, &requests[15]);
+
+        if (trackActivity)
+        {
+            const int dests[N_HALOS] = {north, south, west, east, northWest, northEast, southWest, southEast};
+            const int tags[N_HALOS] = {TAG_NORTH, TAG_SOUTH, TAG_WEST, TAG_EAST, TAG_NORTH_WEST, TAG_NORTH_EAST, TAG_SOUTH_WEST, TAG_SOUTH_EAST};
+            for (int halo = 0; halo < N_HALOS; halo++)
+            {
+                MPI_Send_init(grid, 0, MPI_UINT8_T, dests[halo], tags[halo], cartComm, &emptyRequests[set][halo]);
+            }
+        }
+    }
+    haloSet = 0;
+}
+
+
+/**
+ * Frees the persistent halo requests.
+ * 
+ * @brief Frees the requests of both grids (no exchange may be active) and the halo datatypes.
+ */
+void GameOfLife::freeHaloRequests()
+{
+    for (auto &requests : haloRequests)
+    {
+        for (auto &request : requests)
+        {
+            MPI_Request_free(&request);
+        }
+    }
+    if (trackActivity)
+    {
+        for (auto &requests : emptyRequests)
+        {
+            for (auto &request : requests)
+            {
+                MPI_Request_free(&request);
+            }
+        }
+    }
+    MPI_Type_free(&rowType);
+    MPI_Type_free(&columnType);
+    MPI_Type_free(&cornerType);
+}
+
+
+/**
+ * Starts the halo exchange of currGrid.
+ * 
+ * @brief Starts all receives and sends of the current grid, they complete in finishHaloExchange.
+ *  Nothing depends on buffering, so rows of any length are safe. With active blocks the halos
+ *  that have not changed in the last generation are sent as empty messages.
+ */
+void GameOfLife::startHaloExchange()
+{
+    std::copy(haloRequests[haloSet], haloRequests[haloSet] + 2 * N_HALOS, startedRequests);
+    if (trackActivity)
+    {
+        for (int halo = 0; halo < N_HALOS; halo++)
+        {
+            if (!haloChanged(halo))
+            {
+                startedRequests[N_HALOS + halo] = emptyRequests[haloSet][halo];
+            }
+        }
+    }
+    MPI_Startall(2 * N_HALOS, startedRequests);
+}
+
+
+/**
+ * Finishes the halo exchange of currGrid.
+ * 
+ * @brief Waits for all messages and copies the received columns into the ghost columns
+ *  (an empty column message leaves the last received column in the buffer, which is still valid).
+ */
+void GameOfLife::finishHaloExchange()
+{
+    MPI_Status statuses[2 * N_HALOS];
+    MPI_Waitall(2 * N_HALOS, startedRequests, statuses);
+    if (trackActivity)
+    {
+        receiveGhostChanges(statuses);
+    }
+    const int g = ghostWidth;
+    for (int i = 0; i < localRows; i++)
+    {
+        std::copy(&westColumn[size_t(i) * g], &westColumn[size_t(i + 1) * g], cellAt(currGrid, i, -g));
+        std::copy(&eastColumn[size_t(i) * g], &eastColumn[size_t(i + 1) * g], cellAt(currGrid, i, localCols));
+    }
+}
+
+
+/**
+ * Calculates the interior of the next grid while the halos are in flight.
+ * 
+ * @param thread The calling thread (computes the rows of its band).
+ * @brief Computes the cells of the tile that do not read the ghost zone (all but the outermost
+ *  row and column of the tile) for the first generation after an exchange (of the active blocks
+ *  with -a).
+ */
+void GameOfLife::calculateInterior(int thread)
+{
+    if (trackActivity)
+    {
+        calculateActiveBlocks(thread, true);
+        return;
+    }
+    calculateRows(thread, 1, localRows - 1, 1, localCols - 1);
+}
+
+
+/**
+ * Calculates the boundary of the next grid after the halo exchange.
+ * 
+ * @param thread The calling thread (computes the rows of its band).
+ * @brief Computes the rest of the first generation after an exchange: everything that will be valid
+ *  (all but the outermost ghost row and column) except the cells done by calculateInterior
+ *  (of the active blocks and the blocks next to changed ghost cells with -a).
+ */
+void GameOfLife::calculateBoundary(int thread)
+{
+    if (trackActivity)
+    {
+        calculateActiveBlocks(thread, false);
+        return;
+    }
+    const int g = ghostWidth;
+    calculateRows(thread, 1 - g, 1, 1 - g, localCols + g - 1);
+    calculateRows(thread, localRows - 1, localRows + g - 1, 1 - g, localCols + g - 1);
+    calculateRows(thread, 1, localRows - 1, 1 - g, 1);
+    calculateRows(thread, 1, localRows - 1, localCols - 1, localCols + g - 1);
+}
+
+
+/**
+ * Calculates the valid region of a later generation of the exchange cycle.
+ * 
+ * @param thread The calling thread (computes the rows of its band).
+ * @param first First row and column of the region (tile coordinates, may be negative).
+ * @param rowEnd Row after the region.
+ * @param colEnd Column after the region.
+ * @brief Computes the rectangle [first, rowEnd) x [first, colEnd).
+ */
+void GameOfLife::calculateRegion(int thread, int first, int rowEnd, int colEnd)
+{
+    calculateRows(thread, first, rowEnd, first, colEnd);
+}
+
+
+/**
+ * Calculates a rectangle of the next grid.
+ * 
+ * @param thread The calling thread, only the rows of its band are computed.
+ * @param rowBegin First row (tile coordinates, may be in the ghost zone).
+ * @param rowEnd Row after the rectangle.
+ * @param colBegin First column.
+ * @param colEnd Column after the rectangle.
+ * @brief Runs the row kernel on the columns of every row of the rectangle. The vector kernels
+ *  may also write cells after colEnd: they get the value of the rule for the current grid, which
+ *  is either correct, or they lie outside the valid region and are never read (a row is always
+ *  computed by the same thread, so the threads never write the same cells).
+ */
+void GameOfLife::calculateRows(int thread, int rowBegin, int rowEnd, int colBegin, int colEnd)
+{
+    if (colEnd <= colBegin)
+    {
+        return;
+    }
+    rowBegin = std::max(rowBegin, bandBegin(thread));
+    rowEnd = std::min(rowEnd, bandEnd(thread));
+    for (auto i = rowBegin; i < rowEnd; i++)
+    {
+        rowKernel(cellAt(currGrid, i - 1, colBegin - 1), cellAt(currGrid, i, colBegin - 1), cellAt(currGrid, i + 1, colBegin - 1),
+                  cellAt(nextGrid, i, colBegin - 1), rowSums[thread].data(), colEnd - colBegin, ruleTable.data());
+    }
+}
+
+
+/**
+ * Swaps the current grid with the next grid.
+ * 
+ * @brief Swaps the current grid with the next grid for the next iteration of the simulation.
+ */
+void GameOfLife::swapGrids()
+{
+    std::swap(currGrid, nextGrid);
+    haloSet ^= 1;
+}
+
+
+/**
+ * Prints the grid state.
+ * 
+ * @brief Gathers the tiles on the first process and prints the grid to the standard output.
+ *  The grid is gathered one row of tiles at a time, so the first process never holds
+ *  more than one band of rows.
+ */
+void GameOfLife::printGrid()
+{
+    if (rank != 0)
+    {
+        std::vector<uint8_t> tile = getTile();
+        MPI_Send(tile.data(), tile.size(), MPI_UINT8_T, 0, TAG_TILE, cartComm);
+        return;
+    }
+
+    for (int bandRow = 0; bandRow < dims[0]; bandRow++)
+    {
+        std::vector<std::string> band;
+        for (int bandCol = 0; bandCol < dims[1]; bandCol++)
+        {
+            int tileCoords[N_DIMS] = {bandRow, bandCol}, source, row, col, rows, cols;
+            MPI_Cart_rank(cartComm, tileCoords, &source);
+            tileExtent(tileCoords, row, col, rows, cols);
+            band.resize(rows, std::string(globalCols, '0'));
+
+            std::vector<uint8_t> tile(size_t(rows) * cols);
+            if (source == 0)
+            {
+                tile = getTile();
+            }
+            else
+            {
+                MPI_Recv(tile.data(), tile.size(), MPI_UINT8_T, source, TAG_TILE, cartComm, MPI_STATUS_IGNORE);
+            }
+
+            for (int i = 0; i < rows; i++)
+            {
+                for (int j = 0; j < cols; j++)
+                {
+                    band[i][col + j] = '0' + tile[size_t(i) * cols + j];
+                }
+            }
+        }
+
+        int firstBandRow = (long long)globalRows * bandRow / dims[0];
+        for (size_t i = 0; i < band.size(); i++)
+        {
+            std::cout << firstBandRow + i << ": " << band[i] << '\n';
+        }
+    }
+    std::cout << std::flush;
+}
+
+
+/**
+ * Packs the tile into the bit grid (bits kernel).
+ * 
+ * @brief Converts currGrid to currBits and releases the byte grids, so the simulation
+ *  holds one bit per cell.
+ */
+void GameOfLife::packGrid()
+{
+    rowWords = (localCols + 2 + WORD_BITS - 1) / WORD_BITS;
+    columnWords = (localRows + WORD_BITS - 1) / WORD_BITS;
+    currBits.assign(size_t(localRows + 2) * rowWords, 0);
+    nextBits.assign(currBits.size(), 0);
+    sendBits.assign(columnWords, 0);
+    recvBits.assign(columnWords, 0);
+
+    interiorMask.assign(rowWords, 0);
+    for (int j = 1; j <= localCols; j++)
+    {
+        interiorMask[j / WORD_BITS] |= uint64_t(1) << (j % WORD_BITS);
+    }
+
+    for (int i = 1; i <= localRows; i++)
+    {
+        for (int j = 1; j <= localCols; j++)
+        {
+            if (*cellAt(currGrid, i - 1, j - 1) == ALIVE_CELL)
+            {
+                currBits[size_t(i) * rowWords + j / WORD_BITS] |= uint64_t(1) << (j % WORD_BITS);
+            }
+        }
+    }
+
+    for (auto &buffer : gridBuffers)
+    {
+        buffer.reset();
+    }
+    currGrid = nextGrid = nullptr;
+}
+
+
+/**
+ * Unpacks the bit grid into the tile (bits kernel).
+ * 
+ * @brief Converts currBits back to currGrid for printing and releases the bit grids.
+ */
+void GameOfLife::unpackGrid()
+{
+    allocateGrids();
+    for (int i = 1; i <= localRows; i++)
+    {
+        for (int j = 1; j <= localCols; j++)
+        {
+            *cellAt(currGrid, i - 1, j - 1) = (currBits[size_t(i) * rowWords + j / WORD_BITS] >> (j % WORD_BITS)) & 1;
+        }
+    }
+
+    std::vector<uint64_t>().swap(currBits);
+    std::vector<uint64_t>().swap(nextBits);
+}
+
+
+/**
+ * Communicates the halos of the bit grid between MPI processes (bits kernel).
+ * 
+ * @brief First the west and east columns are exchanged, then the whole rows including the
+ *  just received ghost columns, so the corners reach the diagonal neighbours without extra
+ *  messages. The columns are sent as packed bits (one bit per row) and the rows as their words.
+ */
+void GameOfLife::communicateHaloBits()
+{
+    const int westWord = 1 / WORD_BITS, westBit = 1 % WORD_BITS;
+    const int eastWord = localCols / WORD_BITS, eastBit = localCols % WORD_BITS;
+    const int westGhostWord = 0, westGhostBit = 0;
+    const int eastGhostWord = (localCols + 1) / WORD_BITS, eastGhostBit = (localCols + 1) % WORD_BITS;
+
+    // Collects one column of the interior rows into sendBits
+    auto packColumn = [&](int word, int bit)
+    {
+        std::fill(sendBits.begin(), sendBits.end(), 0);
+        for (int i = 0; i < localRows; i++)
+        {
+            sendBits[i / WORD_BITS] |= ((currBits[size_t(i + 1) * rowWords + word] >> bit) & 1) << (i % WORD_BITS);
+        }
+    };
+    // Stores recvBits into one column of the interior rows
+    auto unpackColumn = [&](int word, int bit)
+    {
+        for (int i = 0; i < localRows; i++)
+        {
+            uint64_t &target = currBits[size_t(i + 1) * rowWords + word];
+            target = (target & ~(uint64_t(1) << bit)) | (((recvBits[i / WORD_BITS] >> (i % WORD_BITS)) & 1) << bit);
+        }
+    };
+
+    packColumn(westWord, westBit);
+    MPI_Sendrecv(sendBits.data(), columnWords, MPI_UINT64_T, west, TAG_WEST,
+                 recvBits.data(), columnWords, MPI_UINT64_T, east, TAG_WEST, cartComm, MPI_STATUS_IGNORE);
+    unpackColumn(eastGhostWord, eastGhostBit);
+
+    packColumn(eastWord, eastBit);
+    MPI_Sendrecv(sendBits.data(), columnWords, MPI_UINT64_T, east, TAG_EAST,
+                 recvBits.data(), columnWords, MPI_UINT64_T, west, TAG_EAST, cartComm, MPI_STATUS_IGNORE);
+    unpackColumn(westGhostWord, westGhostBit);
+
+    MPI_Sendrecv(&currBits[size_t(1) * rowWords], rowWords, MPI_UINT64_T, north, TAG_NORTH,
+                 &currBits[size_t(localRows + 1) * rowWords], rowWords, MPI_UINT64_T, south, TAG_NORTH,
+                 cartComm, MPI_STATUS_IGNORE);
+    MPI_Sendrecv(&currBits[size_t(localRows) * rowWords], rowWords, MPI_UINT64_T, south, TAG_SOUTH,
+                 &currBits[0], rowWords, MPI_UINT64_T, north, TAG_SOUTH, cartComm, MPI_STATUS_IGNORE);
+}
+
+
+/**
+ * Applies a rule known at compile time to bit-sliced neighbour counts (bits kernel).
+ *
+ * @param ones Bits 0 of the counts.
+ * @param twos Bits 1 of the counts.
+ * @param fours Bits 2 of the counts.
+ * @param eights Bits 3 of the counts (only the count 8).
+ * @param alive The cells.
+ * @return The cells alive in the next generation.
+ * @brief The counts Count and Count + 1 differ only in the ones, so every pair of them is one
+ *  match of the twos and fours, and the ones pick the cells that live with the odd or the even
+ *  count. The pairs without a count of the rule are left out and the constant selections of the
+ *  cells are folded by the compiler (B3/S23 is twos & ~fours & (ones | alive)). The count 8 has
+ *  the bits of the count 0 below the eights, so the eights are used only if the rule has 0 or 8.
+ */
+template <uint16_t Birth, uint16_t Survival, int Count = 0>
+static inline uint64_t ruleBits(uint64_t ones, uint64_t twos, uint64_t fours, uint64_t eights, uint64_t alive)
+{
+    if constexpr (Count >= RULE_COUNTS)
+        return 0;
+    else
+    {
+        uint64_t rest = ruleBits<Birth, Survival, Count + 2>(ones, twos, fours, eights, alive);
+        constexpr unsigned even = 1u << Count, odd = 1u << (Count + 1);
+        if constexpr (((Birth | Survival) & (even | odd)) == 0)
+            return rest;
+        else
+        {
+            uint64_t evenLives = ((Birth & even) ? ~alive : 0) | ((Survival & even) ? alive : 0);
+            if constexpr (Count == RULE_COUNTS - 1)
+                return rest | (eights & evenLives);
+            else
+            {
+                uint64_t oddLives = ((Birth & odd) ? ~alive : 0) | ((Survival & odd) ? alive : 0);
+                uint64_t pair = ((Count & 2) ? twos : ~twos) & ((Count & 4) ? fours : ~fours);
+                if constexpr (Count == 0 && ((Birth | Survival) & 1))
+                    pair &= ~eights;
+                return rest | (pair & ((ones & oddLives) | (~ones & evenLives)));
+            }
+        }
+    }
+}
+
+
+/**
+ * Calculates the next state of the bit grid (bits kernel).
+ * 
+ * @brief Computes 64 cells at once: the eight neighbours of every bit are the words of the rows
+ *  above, at and below shifted by one column (with the carry from the adjacent word), and they are
+ *  summed by full adders into a 4-bit count per cell. A rule known at compile time (Birth, Survival)
+ *  is a few logic operations on the bits of the count (ruleBits). The kernel of the runtime rule
+ *  (RULE_RUNTIME) makes the next state of every count from the cells and words of all ones or
+ *  zeros made from the rule masks, then selects the one of the count of every cell by a tree of
+ *  multiplexers over the bits of the count, so it has no branches either.
+ *
+ * @param thread The calling thread (computes the rows of its band).
+ */
+template <uint16_t Birth, uint16_t Survival>
+void GameOfLife::calculateNextBits(int thread)
+{
+    // Adds three bit vectors: sum and carry of every bit position
+    auto fullAdd = [](uint64_t x, uint64_t y, uint64_t z, uint64_t &sum, uint64_t &carry)
+    {
+        uint64_t partial = x ^ y;
+        sum = partial ^ z;
+        carry = (x & y) | (partial & z);
+    };
+
+    // Runtime rule: the next state of a dead cell with a count (all ones or zeros), and the difference to a live cell
+    uint64_t birthWords[RULE_COUNTS], flipWords[RULE_COUNTS];
+    for (int count = 0; count < RULE_COUNTS; count++)
+    {
+        birthWords[count] = ((rule.birth >> count) & 1) ? ~uint64_t(0) : 0;
+        flipWords[count] = (((rule.birth ^ rule.survival) >> count) & 1) ? ~uint64_t(0) : 0;
+    }
+    // Bits of `one` where select is set, of `zero` elsewhere
+    auto mux = [](uint64_t select, uint64_t one, uint64_t zero) { return zero ^ (select & (one ^ zero)); };
+
+    int first = std::max(bandBegin(thread), 0) + 1, last = std::min(bandEnd(thread), localRows);
+    for (int i = first; i <= last; i++)
+    {
+        const uint64_t *above = &currBits[size_t(i - 1) * rowWords];
+        const uint64_t *row = above + rowWords;
+        const uint64_t *below = row + rowWords;
+        uint64_t *next = &nextBits[size_t(i) * rowWords];
+
+        for (int w = 0; w < rowWords; w++)
+        {
+            // Neighbours in the west are one bit lower (shift up), in the east one bit higher (shift down)
+            auto fromWest = [&](const uint64_t *r) { return (r[w] << 1) | (w > 0 ? r[w - 1] >> (WORD_BITS - 1) : 0); };
+            auto fromEast = [&](const uint64_t *r) { return (r[w] >> 1) | (w + 1 < rowWords ? r[w + 1] << (WORD_BITS - 1) : 0); };
+
+            uint64_t sumAbove, carryAbove, sumBelow, carryBelow;
+            fullAdd(fromWest(above), above[w], fromEast(above), sumAbove, carryAbove);
+            fullAdd(fromWest(below), below[w], fromEast(below), sumBelow, carryBelow);
+            uint64_t rowWest = fromWest(row), rowEast = fromEast(row);
+            uint64_t sumRow = rowWest ^ rowEast, carryRow = rowWest & rowEast;
+
+            // Ones, twos (carries of the ones plus the three pair carries), fours and eights of the count
+            uint64_t ones, twosFromOnes, twos, foursFromTwos, fours, eights;
+            fullAdd(sumAbove, sumBelow, sumRow, ones, twosFromOnes);
+            fullAdd(carryAbove, carryBelow, carryRow, twos, foursFromTwos);
+            fours = foursFromTwos ^ (twos & twosFromOnes);
+            eights = foursFromTwos & twos & twosFromOnes;
+            twos ^= twosFromOnes;
+
+            uint64_t lives;
+            if constexpr (Birth == RULE_RUNTIME_MASK)
+            {
+                uint64_t state[RULE_COUNTS];
+                for (int count = 0; count < RULE_COUNTS; count++)
+                {
+                    state[count] = birthWords[count] ^ (row[w] & flipWords[count]);
+                }
+                lives = mux(fours, mux(twos, mux(ones, state[7], state[6]), mux(ones, state[5], state[4])),
+                            mux(twos, mux(ones, state[3], state[2]), mux(ones, state[1], state[0])));
+                lives = mux(eights, state[8], lives);
+            }
+            else
+            {
+                lives = ruleBits<Birth, Survival>(ones, twos, fours, eights, row[w]);
+            }
+            next[w] = lives & interiorMask[w];
+        }
+    }
+}
+
+
+/**
+ * Allocates the block flags of the active-block tracking.
+ * 
+ * @brief All blocks start as changed, so the first generation computes the whole tile and sends all halos.
+ */
+void GameOfLife::allocateBlocks()
+{
+    blockRows = (localRows + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    blockCols = (localCols + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    blockChanged.assign(size_t(blockRows) * blockCols, UINT16_MAX);
+    blockActive.assign(blockChanged.size(), 1);
+    ghostActive.assign(blockChanged.size(), 0);
+    threadChanged.assign(noThreads, std::vector<uint16_t>(blockChanged.size(), 0));
+    nextRows.assign(noThreads, std::vector<uint8_t>(stride, 0));
+}
+
+
+/**
+ * Returns the blocks at the edge of the tile a halo is sent from (and its ghost cells are next to).
+ * 
+ * @param halo The halo: north, south, west, east, north-west, north-east, south-west, south-east.
+ * @param rowBegin First block row.
+ * @param rowEnd Block row after the blocks.
+ * @param colBegin First block column.
+ * @param colEnd Block column after the blocks.
+ */
+void GameOfLife::haloBlocks(int halo, int &rowBegin, int &rowEnd, int &colBegin, int &colEnd) const
+{
+    const bool northern[N_HALOS] = {true, false, false, false, true, true, false, false};
+    const bool southern[N_HALOS] = {false, true, false, false, false, false, true, true};
+    const bool western[N_HALOS] = {false, false, true, false, true, false, true, false};
+    const bool eastern[N_HALOS] = {false, false, false, true, false, true, false, true};
+
+    rowBegin = southern[halo] ? blockRows - 1 : 0;
+    rowEnd = northern[halo] ? 1 : blockRows;
+    colBegin = eastern[halo] ? blockCols - 1 : 0;
+    colEnd = western[halo] ? 1 : blockCols;
+}
+
+
+/**
+ * Checks if a halo of currGrid has changed in the last generation.
+ * 
+ * @param halo The halo (see haloBlocks).
+ * @return true if a cell of the halo has changed (a block at the edge of the tile changed at that edge).
+ */
+bool GameOfLife::haloChanged(int halo) const
+{
+    int rowBegin, rowEnd, colBegin, colEnd;
+    haloBlocks(halo, rowBegin, rowEnd, colBegin, colEnd);
+    for (int i = rowBegin; i < rowEnd; i++)
+    {
+        for (int j = colBegin; j < colEnd; j++)
+        {
+            if (blockChanged[i * blockCols + j] & (CHANGE_NORTH << halo))
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+
+/**
+ * Processes the received halos (active blocks).
+ * 
+ * @param statuses Statuses of the receives of the exchange.
+ * @brief A full message has changed ghost cells, the blocks next to them are computed in the boundary.
+ *  An empty message means the ghost cells are the same as in the last generation, the rows and corners
+ *  (received in place) are copied from nextGrid, which still holds them.
+ */
+void GameOfLife::receiveGhostChanges(MPI_Status statuses[N_HALOS])
+{
+    const int g = ghostWidth;
+    // Ghost cells received in place: first row, rows, first column and columns (none for the columns)
+    const int ghostRows[N_HALOS][2] = {{-g, g}, {localRows, g}, {0, 0}, {0, 0}, {-g, g}, {-g, g}, {localRows, g}, {localRows, g}};
+    const int ghostCols[N_HALOS][2] = {{0, localCols}, {0, localCols}, {0, 0}, {0, 0}, {-g, g}, {localCols, g}, {-g, g}, {localCols, g}};
+
+    const MPI_Datatype types[N_HALOS] = {rowType, rowType, MPI_UINT8_T, MPI_UINT8_T, cornerType, cornerType, cornerType, cornerType};
+
+    std::fill(ghostActive.begin(), ghostActive.end(), 0);
+    for (int halo = 0; halo < N_HALOS; halo++)
+    {
+        int count;
+        MPI_Get_count(&statuses[halo], types[halo], &count);
+        if (count > 0)
+        {
+            int rowBegin, rowEnd, colBegin, colEnd;
+            haloBlocks(halo, rowBegin, rowEnd, colBegin, colEnd);
+            for (int i = rowBegin; i < rowEnd; i++)
+            {
+                std::fill_n(&ghostActive[i * blockCols + colBegin], colEnd - colBegin, 1);
+            }
+            continue;
+        }
+        for (int i = ghostRows[halo][0]; i < ghostRows[halo][0] + ghostRows[halo][1]; i++)
+        {
+            const uint8_t *previous = cellAt(nextGrid, i, ghostCols[halo][0]);
+            std::copy(previous, previous + ghostCols[halo][1], cellAt(currGrid, i, ghostCols[halo][0]));
+        }
+    }
+}
+
+
+/**
+ * Calculates the active blocks of the next grid.
+ * 
+ * @param thread The calling thread (computes the rows of its band).
+ * @param interior true for the interior of the tile (see calculateInterior), false for its boundary
+ *  (see calculateBoundary, also computed in the blocks next to changed ghost cells).
+ * @brief The blocks that are not computed keep their cells from two generations ago in nextGrid,
+ *  which are also their current cells, because neither they nor their neighbours have changed since.
+ */
+void GameOfLife::calculateActiveBlocks(int thread, bool interior)
+{
+    for (int bi = 0; bi < blockRows; bi++)
+    {
+        for (int bj = 0; bj < blockCols; bj++)
+        {
+            int block = bi * blockCols + bj;
+            if (!blockActive[block] && (interior || !ghostActive[block]))
+            {
+                continue;
+            }
+
+            int top = bi * BLOCK_SIZE, bottom = std::min(top + BLOCK_SIZE, localRows);
+            int left = bj * BLOCK_SIZE, right = std::min(left + BLOCK_SIZE, localCols);
+            if (interior)
+            {
+                calculateBlockRows(thread, block, std::max(top, 1), std::min(bottom, localRows - 1), std::max(left, 1), std::min(right, localCols - 1));
+                continue;
+            }
+            calculateBlockRows(thread, block, top, std::min(bottom, 1), left, right);
+            calculateBlockRows(thread, block, std::max(top, localRows - 1), bottom, left, right);
+            calculateBlockRows(thread, block, std::max(top, 1), std::min(bottom, localRows - 1), left, std::min(right, 1));
+            calculateBlockRows(thread, block, std::max(top, 1), std::min(bottom, localRows - 1), std::max(left, localCols - 1), right);
+        }
+    }
+}
+
+
+/**
+ * Calculates a rectangle of a block of the next grid and records its changes.
+ * 
+ * @param thread The calling thread, only the rows of its band are computed.
+ * @param block The block of the rectangle.
+ * @param rowBegin First row (tile coordinates).
+ * @param rowEnd Row after the rectangle.
+ * @param colBegin First column.
+ * @param colEnd Column after the rectangle.
+ * @brief Unlike calculateRows the rows are computed into the scratch row of the thread and only the
+ *  rectangle is copied to nextGrid: the cells the vector kernels write past it may belong to blocks
+ *  that are not computed, and the cells at the edge of the tile would be written before the exchange.
+ */
+void GameOfLife::calculateBlockRows(int thread, int block, int rowBegin, int rowEnd, int colBegin, int colEnd)
+{
+    if (colEnd <= colBegin)
+    {
+        return;
+    }
+    rowBegin = std::max(rowBegin, bandBegin(thread));
+    rowEnd = std::min(rowEnd, bandEnd(thread));
+
+    const int top = block / blockCols * BLOCK_SIZE, bottom = std::min(top + BLOCK_SIZE, localRows);
+    const int left = block % blockCols * BLOCK_SIZE, right = std::min(left + BLOCK_SIZE, localCols);
+    const int cols = colEnd - colBegin;
+    uint8_t *next = nextRows[thread].data();
+    uint16_t changes = 0;
+    for (auto i = rowBegin; i < rowEnd; i++)
+    {
+        const uint8_t *curr = cellAt(currGrid, i, colBegin);
+        rowKernel(curr - stride - 1, curr - 1, curr + stride - 1, next, rowSums[thread].data(), cols, ruleTable.data());
+        std::copy(next + 1, next + 1 + cols, cellAt(nextGrid, i, colBegin));
+
+        // The first and the last changed cell of the row tell if it changed at the edges of the block
+        const uint8_t *first = std::mismatch(next + 1, next + 1 + cols, curr).first;
+        if (first == next + 1 + cols)
+        {
+            continue;
+        }
+        int firstCol = colBegin + (first - next - 1);
+        int lastCol = colEnd - 1 - (std::mismatch(std::make_reverse_iterator(next + 1 + cols), std::make_reverse_iterator(next + 1),
+                                                  std::make_reverse_iterator(curr + cols)).first - std::make_reverse_iterator(next + 1 + cols));
+        changes |= CHANGE_CELLS;
+        changes |= (i == top ? CHANGE_NORTH : 0) | (i == bottom - 1 ? CHANGE_SOUTH : 0);
+        if (firstCol == left)
+        {
+            changes |= CHANGE_WEST | (i == top ? CHANGE_NORTH_WEST : 0) | (i == bottom - 1 ? CHANGE_SOUTH_WEST : 0);
+        }
+        if (lastCol == right - 1)
+        {
+            changes |= CHANGE_EAST | (i == top ? CHANGE_NORTH_EAST : 0) | (i == bottom - 1 ? CHANGE_SOUTH_EAST : 0);
+        }
+    }
+    threadChanged[thread][block] |= changes;
+}
+
+
+/**
+ * Updates the active blocks after a generation.
+ * 
+ * @brief Collects the changes found by the threads. The blocks to compute in the next generation
+ *  are the changed blocks and the neighbours in the tile next to a changed edge or corner (the
+ *  neighbours across the edge of the tile are woken by the halos). Runs on one thread after the
+ *  grids are swapped.
+ */
+void GameOfLife::updateActivity()
+{
+    if (!trackActivity)
+    {
+        return;
+    }
+
+    std::fill(blockChanged.begin(), blockChanged.end(), 0);
+    for (auto &changed : threadChanged)
+    {
+        for (size_t block = 0; block < changed.size(); block++)
+        {
+            blockChanged[block] |= changed[block];
+        }
+        std::fill(changed.begin(), changed.end(), 0);
+    }
+
+    // Neighbour blocks in the order of the changes of the edges and corners
+    const int rowOffsets[N_HALOS] = {-1, 1, 0, 0, -1, -1, 1, 1};
+    const int colOffsets[N_HALOS] = {0, 0, -1, 1, -1, 1, -1, 1};
+
+    std::fill(blockActive.begin(), blockActive.end(), 0);
+    for (int bi = 0; bi < blockRows; bi++)
+    {
+        for (int bj = 0; bj < blockCols; bj++)
+        {
+            uint16_t changes = blockChanged[bi * blockCols + bj];
+            if (!(changes & CHANGE_CELLS))
+            {
+                continue;
+            }
+            blockActive[bi * blockCols + bj] = 1;
+            for (int direction = 0; direction < N_HALOS; direction++)
+            {
+                int i = bi + rowOffsets[direction], j = bj + colOffsets[direction];
+                if ((changes & (CHANGE_NORTH << direction)) && i >= 0 && i < blockRows && j >= 0 && j < blockCols)
+                {
+                    blockActive[i * blockCols + j] = 1;
+                }
+            }
+        }
+    }
+}
+
+
+/**
+ * Starts the worker threads.
+ * 
+ * @brief Starts noThreads - 1 workers. If the process may run on at least noThreads CPUs, thread t
+ *  (the main thread is thread 0) is pinned to the t-th of them, so it keeps the pages it touched first.
+ */
+void GameOfLife::createThreads()
+{
+    threadBarrier.reset(new ThreadBarrier(noThreads));
+    for (int thread = 1; thread < noThreads; thread++)
+    {
+        workers.emplace_back(&GameOfLife::threadLoop, this, thread);
+    }
+
+    cpu_set_t allowed;
+    if (noThreads < 2 || sched_getaffinity(0, sizeof(allowed), &allowed) != 0 || CPU_COUNT(&allowed) < noThreads)
+    {
+        return;
+    }
+    for (int thread = 0, cpu = 0; thread < noThreads; cpu++)
+    {
+        if (CPU_ISSET(cpu, &allowed))
+        {
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            CPU_SET(cpu, &cpus);
+            pthread_t handle = thread == 0 ? pthread_self() : workers[thread - 1].native_handle();
+            pthread_setaffinity_np(handle, sizeof(cpus), &cpus);
+            thread++;
+        }
+    }
+}
+
+
+/**
+ * Stops the worker threads.
+ * 
+ * @brief Releases the workers from the barrier with the stop flag set and waits for them.
+ */
+void GameOfLife::joinThreads()
+{
+    if (workers.empty())
+    {
+        return;
+    }
+    stopWorkers = true;
+    threadBarrier->wait();
+    for (auto &worker : workers)
+    {
+        worker.join();
+    }
+    workers.clear();
+}
+
+
+/**
+ * Main loop of a worker thread.
+ * 
+ * @param thread The thread.
+ * @brief Waits for work from runThreads, runs it and reports back, until the threads are stopped.
+ */
+void GameOfLife::threadLoop(int thread)
+{
+    while (true)
+    {
+        threadBarrier->wait();
+        if (stopWorkers)
+        {
+            return;
+        }
+        threadWork(thread);
+        threadBarrier->wait();
+    }
+}
+
+
+/**
+ * Runs work on all threads of the process.
+ * 
+ * @param work The work, called with the number of the thread (0 on the main thread).
+ * @brief Returns when all threads have finished. The work may synchronize the threads with threadBarrier.
+ */
+void GameOfLife::runThreads(const std::function<void(int)> &work)
+{
+    if (workers.empty())
+    {
+        work(0);
+        return;
+    }
+    threadWork = work;
+    threadBarrier->wait();
+    work(0);
+    threadBarrier->wait();
+}
+
+
+/**
+ * Returns the first row of the band of a thread.
+ * 
+ * @param thread The thread.
+ * @return First row of the band (tile coordinates), the first thread also has the ghost rows above the tile.
+ */
+int GameOfLife::bandBegin(int thread) const
+{
+    return thread == 0 ? -ghostWidth : localRows * thread / noThreads;
+}
+
+
+/**
+ * Returns the row after the band of a thread.
+ * 
+ * @param thread The thread.
+ * @return Row after the band (tile coordinates), the last thread also has the ghost rows below the tile.
+ */
+int GameOfLife::bandEnd(int thread) const
+{
+    return thread == noThreads - 1 ? localRows + ghostWidth : localRows * (thread + 1) / noThreads;
+}
+
+
+/**
+ * Runs the Game of Life simulation.
+ * 
+ * @brief Executes the main simulation loop for the specified number of time steps.
+ */
+void GameOfLife::runSimulation()
+{
+    if (engine == ENGINE_HASHLIFE)
+    {
+        if (rank == 0)
+        {
+            runHashLife();
+        }
+        if (printResult && !outputPath.empty())
+        {
+            writeOutputFile(wholeGrid, 0, 0, rank == 0 ? globalRows : 0, globalCols);
+        }
+        return;
+    }
+
+    // Processes that did not get a tile have nothing to do (but take part in writing the output file)
+    if (cartComm == MPI_COMM_NULL)
+    {
+        if (printResult && !outputPath.empty())
+        {
+            writeOutputFile(std::vector<uint8_t>(), 0, 0, 0, 0);
+        }
+        return;
+    }
+
+    // The main thread starts the due checkpoints while the other threads compute (or wait for the halos)
+    if (checkpointInterval > 0)
+    {
+        openCheckpoint();
+    }
+    threadHashes.assign(noThreads, 0);
+    double start = MPI_Wtime();
+
+    if (kernel == KERNEL_BITS)
+    {
+        packGrid();
+        runThreads([&](int thread)
+        {
+            for (long long currTime = startTime; currTime < gameTime;)
+            {
+                if (thread == 0)
+                {
+                    startCheckpoint(currTime);
+                    double haloStart = MPI_Wtime();
+                    communicateHaloBits();
+                    runStatistics.haloSeconds += MPI_Wtime() - haloStart;
+                    runStatistics.generations++;
+                    progressCheckpoint();
+                }
+                threadBarrier->wait();
+                (this->*bitsKernel)(thread);
+                threadBarrier->wait([this] { currBits.swap(nextBits); });
+                currTime = detectCycle(thread, currTime + 1);
+            }
+        });
+        unpackGrid();
+    }
+    else
+    {
+        if (tuneGhosts)
+        {
+            tuneGhostWidth();
+        }
+
+        // One exchange per ghostWidth generations, the interior of the first one is computed while
+        // the halos are in flight, every further one computes one cell less on every side.
+        // The main thread exchanges the halos, the last thread to finish a generation swaps the grids
+        if (trackActivity)
+        {
+            allocateBlocks();
+        }
+        createHaloRequests();
+        runThreads([&](int thread)
+        {
+            for (long long currTime = startTime; currTime < gameTime;)
+            {
+                // A cycle ends at the next checkpoint
+                long long steps = std::min<long long>(ghostWidth, gameTime - currTime);
+                if (checkpointInterval > 0)
+                {
+                    steps = std::min(steps, checkpointInterval - currTime % checkpointInterval);
+                }
+                if (thread == 0)
+                {
+                    startCheckpoint(currTime);
+                    double haloStart = MPI_Wtime();
+                    startHaloExchange();
+                    runStatistics.haloSeconds += MPI_Wtime() - haloStart;
+                    runStatistics.generations += steps;
+                }
+                calculateInterior(thread);
+                if (thread == 0)
+                {
+                    double haloStart = MPI_Wtime();
+                    finishHaloExchange();
+                    runStatistics.haloSeconds += MPI_Wtime() - haloStart;
+                    progressCheckpoint();
+                }
+                threadBarrier->wait();
+                calculateBoundary(thread);
+                threadBarrier->wait([this] { swapGrids(); updateActivity(); });
+                for (int step = 2; step <= steps; step++)
+                {
+                    int shrink = ghostWidth - step;
+                    calculateRegion(thread, -shrink, localRows + shrink, localCols + shrink);
+                    threadBarrier->wait([this] { swapGrids(); updateActivity(); });
+                }
+                currTime = detectCycle(thread, currTime + steps);
+            }
+        });
+        freeHaloRequests();
+    }
+    runStatistics.seconds = MPI_Wtime() - start;
+    closeCheckpoint();
+
+    if (!printResult)
+    {
+        return;
+    }
+    if (outputPath.empty())
+    {
+        printGrid();
+    }
+    else
+    {
+        writeOutputFile(getTile(), firstRow, firstCol, localRows, localCols);
+    }
+}
+
+
+/**
+ * Runs the simulation with the HashLife engine (first process).
+ * 
+ * @brief Advances the whole grid by the game time and prints it like printGrid (unless it is
+ *  written into a file), the statistics of the node cache go to the standard error output.
+ */
+void GameOfLife::runHashLife()
+{
+    HashLife hashLife(globalRows, globalCols, cacheNodes, rule);
+    double start = MPI_Wtime();
+    hashLife.run(wholeGrid, gameTime - startTime);
+    runStatistics.seconds = MPI_Wtime() - start;
+    runStatistics.generations = gameTime - startTime;
+
+    for (int i = 0; i < globalRows && printResult && outputPath.empty(); i++)
+    {
+        std::string row(globalCols, '0');
+        for (int j = 0; j < globalCols; j++)
+        {
+            row[j] = '0' + wholeGrid[size_t(i) * globalCols + j];
+        }
+        std::cout << i << ": " << row << '\n';
+    }
+    std::cout << std::flush;
+    hashLife.printStatistics(std::cerr);
+}
+
+
+/**
+ * Constructor of the HashLife engine.
+ *
+ * @param rows Rows of the grid.
+ * @param cols Columns of the grid.
+ * @param maxNodes Bound of the node cache.
+ * @param rule The rule.
+ * @brief Creates the two cells (nodes 0 and 1).
+ */
+HashLife::HashLife(int rows, int cols, size_t maxNodes, const Rule &rule)
+    : rows(rows), cols(cols), maxNodes(maxNodes), collectAt(maxNodes), rule(rule)
+{
+    for (int cell = DEAD_CELL; cell <= ALIVE_CELL; cell++)
+    {
+        nodes.push_back({{NO_NODE, NO_NODE, NO_NODE, NO_NODE}, NO_NODE, 0, false});
+    }
+}
+
+
+/**
+ * Hashes the children of a node.
+ *
+ * @param children The children.
+ * @return The hash.
+ */
+size_t HashLife::ChildrenHash::operator()(const std::array<uint32_t, 4> &children) const
+{
+    uint64_t hash = 0;
+    for (uint32_t child : children)
+    {
+        hash = (hash ^ child) * 0x9e3779b97f4a7c15ULL;
+        hash ^= hash >> 29;
+    }
+    return hash;
+}
+
+
+/**
+ * Advances the grid.
+ *
+ * @param cells The grid (row by row), replaced by the grid after the generations.
+ * @param generations Number of generations (below 2^(HASHLIFE_MAX_POWER + 1)).
+ * @brief Advances the grid by every power of two of the number of generations.
+ */
+void HashLife::run(std::vector<uint8_t> &cells, long long generations)
+{
+    for (int power = 0; power <= HASHLIFE_MAX_POWER && (generations >> power) > 0; power++)
+    {
+        if ((generations >> power) & 1)
+        {
+            advance(cells, power);
+        }
+    }
+}
+
+
+/**
+ * Advances the grid by a power of two of generations.
+ *
+ * @param cells The grid (row by row), replaced by the grid after the generations.
+ * @param power The power: 2^power generations.
+ * @brief The grid is covered by windows of 2^(power + 1) x 2^(power + 1) cells, every window is the result
+ *  of the block of the plane of twice its size around it.
+ */
+void HashLife::advance(std::vector<uint8_t> &cells, int power)
+{
+    blocks.clear();
+    grid = &cells;
+    std::vector<uint8_t> next(cells.size(), DEAD_CELL);
+
+    const long long window = 1LL << (power + 1);
+    auto wrap = [](long long position, long long size) { return (position % size + size) % size; };
+    for (long long row = 0; row < rows; row += window)
+    {
+        for (long long col = 0; col < cols; col += window)
+        {
+            uint32_t around = block(power + 2, wrap(row - window / 2, rows), wrap(col - window / 2, cols));
+            extract(result(around), row, col, next);
+        }
+    }
+
+    cells.swap(next);
+    grid = nullptr;
+}
+
+
+/**
+ * Returns the node of a block of the plane of the current grid.
+ *
+ * @param level Level of the block.
+ * @param row First row of the block in the grid (0 <= row < rows).
+ * @param col First column of the block in the grid (0 <= col < cols).
+ * @return The node.
+ */
+uint32_t HashLife::block(int level, long long row, long long col)
+{
+    if (level == 0)
+    {
+        return (*grid)[row * cols + col];
+    }
+
+    const uint64_t key = uint64_t(level) << 58 | uint64_t(row) << 29 | uint64_t(col);
+    auto found = blocks.find(key);
+    if (found != blocks.end())
+    {
+        return found->second;
+    }
+
+    const long long half = 1LL << (level - 1);
+    const long long south = (row + half) % rows, east = (col + half) % cols;
+    uint32_t node = join(block(level - 1, row, col), block(level - 1, row, east),
+                         block(level - 1, south, col), block(level - 1, south, east));
+    blocks.emplace(key, node);
+    return node;
+}
+
+
+/**
+ * Returns the node with the given children.
+ *
+ * @param nw North-west child.
+ * @param ne North-east child.
+ * @param sw South-west child.
+ * @param se South-east child.
+ * @return The existing node with the children, or a new one.
+ */
+uint32_t HashLife::join(uint32_t nw, uint32_t ne, uint32_t sw, uint32_t se)
+{
+    const std::array<uint32_t, 4> children = {nw, ne, sw, se};
+    auto found = nodeTable.find(children);
+    if (found != nodeTable.end())
+    {
+        return found->second;
+    }
+
+    Node node = {{nw, ne, sw, se}, NO_NODE, uint8_t(nodes[nw].level + 1), false};
+    uint32_t id;
+    if (!freeNodes.empty())
+    {
+        id = freeNodes.back();
+        freeNodes.pop_back();
+        nodes[id] = node;
+    }
+    else
+    {
+        id = nodes.size();
+        nodes.push_back(node);
+    }
+    nodeTable.emplace(children, id);
+    peakNodes = std::max(peakNodes, liveNodes());
+    return id;
+}
+
+
+/**
+ * Returns the result of a node.
+ *
+ * @param node The node (level 2 or more).
+ * @return The center half of the node after 2^(level - 2) generations (a node of level - 1).
+ * @brief The nine overlapping sub-blocks of half the size are advanced by 2^(level - 3) generations,
+ *  their results make four overlapping blocks, which are advanced by 2^(level - 3) generations again.
+ *  The node and the results computed so far are pinned, so the cache can be collected before every
+ *  result (the nodes are never moved, only freed).
+ */
+uint32_t HashLife::result(uint32_t node)
+{
+    if (nodes[node].result != NO_NODE)
+    {
+        resultsReused++;
+        return nodes[node].result;
+    }
+
+    const size_t pinnedBefore = pinned.size();
+    pinned.push_back(node);
+    if (liveNodes() > collectAt)
+    {
+        collect();
+    }
+    auto pin = [&](uint32_t id) { pinned.push_back(id); return id; };
+
+    uint32_t computed;
+    if (nodes[node].level == 2)
+    {
+        computed = baseResult(node);
+    }
+    else
+    {
+        // The vector of the nodes may grow in join, so the children are looked up by id
+        auto child = [&](uint32_t id, int quadrant) { return nodes[id].child[quadrant]; };
+        const uint32_t nw = child(node, 0), ne = child(node, 1), sw = child(node, 2), se = child(node, 3);
+
+        const uint32_t r00 = pin(result(nw));
+        const uint32_t r01 = pin(result(join(child(nw, 1), child(ne, 0), child(nw, 3), child(ne, 2))));
+        const uint32_t r02 = pin(result(ne));
+        const uint32_t r10 = pin(result(join(child(nw, 2), child(nw, 3), child(sw, 0), child(sw, 1))));
+        const uint32_t r11 = pin(result(join(child(nw, 3), child(ne, 2), child(sw, 1), child(se, 0))));
+        const uint32_t r12 = pin(result(join(child(ne, 2), child(ne, 3), child(se, 0), child(se, 1))));
+        const uint32_t r20 = pin(result(sw));
+        const uint32_t r21 = pin(result(join(child(sw, 1), child(se, 0), child(sw, 3), child(se, 2))));
+        const uint32_t r22 = pin(result(se));
+
+        const uint32_t resultNw = pin(result(join(r00, r01, r10, r11)));
+        const uint32_t resultNe = pin(result(join(r01, r02, r11, r12)));
+        const uint32_t resultSw = pin(result(join(r10, r11, r20, r21)));
+        const uint32_t resultSe = pin(result(join(r11, r12, r21, r22)));
+        computed = join(resultNw, resultNe, resultSw, resultSe);
+    }
+
+    nodes[node].result = computed;
+    resultsComputed++;
+    pinned.resize(pinnedBefore);
+    return computed;
+}
+
+
+/**
+ * Returns the result of a node of level 2.
+ *
+ * @param node The node (4 x 4 cells).
+ * @return The center 2 x 2 cells after one generation.
+ */
+uint32_t HashLife::baseResult(uint32_t node)
+{
+    int cells[4][4];
+    for (int quadrant = 0; quadrant < 4; quadrant++)
+    {
+        const Node &quarter = nodes[nodes[node].child[quadrant]];
+        for (int cell = 0; cell < 4; cell++)
+        {
+            cells[quadrant / 2 * 2 + cell / 2][quadrant % 2 * 2 + cell % 2] = quarter.child[cell];
+        }
+    }
+
+    uint32_t next[4];
+    for (int i = 1; i <= 2; i++)
+    {
+        for (int j = 1; j <= 2; j++)
+        {
+            int neighbours = -cells[i][j];
+            for (int di = -1; di <= 1; di++)
+            {
+                for (int dj = -1; dj <= 1; dj++)
+                {
+                    neighbours += cells[i + di][j + dj];
+                }
+            }
+            const uint16_t lives = cells[i][j] == ALIVE_CELL ? rule.survival : rule.birth;
+            next[(i - 1) * 2 + j - 1] = ((lives >> neighbours) & 1) ? ALIVE_CELL : DEAD_CELL;
+        }
+    }
+    return join(next[0], next[1], next[2], next[3]);
+}
+
+
+/**
+ * Copies the cells of a node into the grid.
+ *
+ * @param node The node.
+ * @param row Row of the first cell of the node (the cells outside the grid are skipped).
+ * @param col Column of the first cell of the node.
+ * @param cells The grid.
+ */
+void HashLife::extract(uint32_t node, long long row, long long col, std::vector<uint8_t> &cells) const
+{
+    if (row >= rows || col >= cols)
+    {
+        return;
+    }
+    const Node &current = nodes[node];
+    if (current.level == 0)
+    {
+        cells[row * cols + col] = node;
+        return;
+    }
+
+    const long long half = 1LL << (current.level - 1);
+    extract(current.child[0], row, col, cells);
+    extract(current.child[1], row, col + half, cells);
+    extract(current.child[2], row + half, col, cells);
+    extract(current.child[3], row + half, col + half, cells);
+}
+
+
+/**
+ * Collects the nodes that are not part of the plane of the current grid.
+ *
+ * @brief Marks the blocks of the current grid, the pinned nodes and their descendants, then the
+ *  memoized results of the marked nodes with their descendants (the work needed to continue).
+ *  The other nodes are freed and the results pointing to them are forgotten. If the marked nodes
+ *  alone exceed the bound, the next collection waits until half as many new nodes (at least half
+ *  the bound) are created, so the cost of the collections stays proportional to the new nodes.
+ */
+void HashLife::collect()
+{
+    for (auto &node : nodes)
+    {
+        node.marked = false;
+    }
+
+    std::vector<uint32_t> stack = {DEAD_CELL, ALIVE_CELL};
+    stack.insert(stack.end(), pinned.begin(), pinned.end());
+    for (const auto &entry : blocks)
+    {
+        stack.push_back(entry.second);
+    }
+    std::vector<uint32_t> results;
+    auto mark = [&](bool withResults)
+    {
+        while (!stack.empty())
+        {
+            uint32_t id = stack.back();
+            stack.pop_back();
+            if (nodes[id].marked)
+            {
+                continue;
+            }
+            nodes[id].marked = true;
+            if (nodes[id].level > 0)
+            {
+                stack.insert(stack.end(), nodes[id].child, nodes[id].child + 4);
+            }
+            if (withResults && nodes[id].result != NO_NODE)
+            {
+                results.push_back(nodes[id].result);
+            }
+        }
+    };
+    mark(true);
+    stack.swap(results);
+    mark(false);
+
+    nodeTable.clear();
+    freeNodes.clear();
+    for (uint32_t id = 0; id < nodes.size(); id++)
+    {
+        Node &node = nodes[id];
+        if (!node.marked)
+        {
+            freeNodes.push_back(id);
+            continue;
+        }
+        if (node.result != NO_NODE && !nodes[node.result].marked)
+        {
+            node.result = NO_NODE;
+        }
+        if (node.level > 0)
+        {
+            nodeTable.emplace(std::array<uint32_t, 4>{node.child[0], node.child[1], node.child[2], node.child[3]}, id);
+        }
+    }
+
+    collections++;
+    collectAt = std::max(maxNodes, liveNodes() + std::max(maxNodes, liveNodes()) / 2);
+}
+
+
+/**
+ * Returns the number of nodes in the cache.
+ *
+ * @return Nodes that are not free.
+ */
+size_t HashLife::liveNodes() const
+{
+    return nodes.size() - freeNodes.size();
+}
+
+
+/**
+ * Prints the statistics of the node cache.
+ *
+ * @param out The stream.
+ * @brief Nodes, their peak and memory (nodes and the hash table), collections and memoized results.
+ */
+void HashLife::printStatistics(std::ostream &out) const
+{
+    const size_t tableEntry = sizeof(std::array<uint32_t, 4>) + sizeof(uint32_t) + 2 * sizeof(void *);
+    const double bytes = nodes.capacity() * sizeof(Node) + nodeTable.size() * tableEntry + nodeTable.bucket_count() * sizeof(void *);
+    out << "HashLife: " << liveNodes() << " nodes (peak " << peakNodes << ", " << bytes / (1024 * 1024) << " MiB), "
+        << collections << " collections, " << resultsComputed << " results computed, " << resultsReused << " reused" << std::endl;
+}
+
+
+#ifndef LIFE_NO_MAIN
+/**
+ * Entry point for the Game of Life program.
+ * 
+ * @param argc Number of command-line arguments.
+ * @param argv Array of command-line arguments.
+ * @return Returns 0 upon successful execution of the program.
+ * @brief Parses command-line arguments, initializes the GameOfLife object, runs the simulation, and returns the result.
+ */
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        fprintf(stderr, "Usage: %s <file.txt> <game time>\n", argv[0]);
+        return 1;
+    }
+
+    GameOfLife game(argc, argv);
+    game.readInputFile(argv[1]);
+    game.runSimulation();
+
+    return 0;
+}
+#endif
@@ -0,0 +1,683 @@
+/********************************************************************************
+ * @file    life_harness.cpp
+ * @author  Filip Jahn (xjahnf00)
+ * @date    2024-04-16
+ * Subject  PRL
+ * @brief   Golden tests and benchmarks of the Game of Life engine (life.cpp) in one MPI job.
+ *
+ * @note The engine is built into the harness (life.cpp with LIFE_NO_MAIN), every test or measurement
+ * creates a GameOfLife object on all processes, so no mpirun is started per case.
+ *
+ * @note To compile the harness:
+ *      mpic++ --prefix /usr/local/share/OpenMPI --std=c++17 -O2 -o life_harness life_harness.cpp -lpthread
+ *
+ * @note To run it:
+ *      mpirun --oversubscribe --prefix /usr/local/share/OpenMPI -np <processes> life_harness golden [-d dir] [-- life options]
+ *      mpirun --oversubscribe --prefix /usr/local/share/OpenMPI -np <processes> life_harness bench [options] [-- life options]
+ *
+ * @note golden runs every i_<N>.txt of every case of the tests directory (default my_tests) with the
+ * life options and compares the printed grid with it. Then random grids (up to 1000 x 1000) are
+ * computed by every kernel and layout under the rules of GOLDEN_RULES (the specialized kernels and the
+ * kernels of the runtime rule) and compared with HashLife (without the bits kernel if the life options
+ * have -g or -a, which it does not support), and by the byte kernels with -g auto (unless the options
+ * have -g or -a). Last, a blinker is run by the byte kernels with the cycle detection and checkpoints
+ * (-p 4 -s 7 -g 3), it has to skip the periods. Exits with 1 if a test failed.
+ *
+ * @note bench measures the grid engine on random grids (density 0.35) for every kernel and layout:
+ *      -s sizes        Sides of the square grids of the strong scaling (default 10000), e.g. 10000,31623,100000.
+ *                      A side of 100000 needs about 2 * 10^10 bytes in total (two byte grids).
+ *      -w side         Side of the grid of one process in the weak scaling (default 2048, 0 for none).
+ *      -g generations  Generations of every measurement (default 10).
+ *      -k kernels      Kernels (default all the CPU supports).
+ *      -l layouts      Layouts (default tiles,rows).
+ *      -n processes    Numbers of processes (default 1, 2, 4, ... and all processes of the job).
+ *
+ * @note The results are printed as JSON lines to the standard output (one object per test or measurement):
+ * the cell updates per second, the time of the slowest process, its time in the halo exchanges and the
+ * compute time (the rest), the speedup and the efficiency against the first number of processes.
+ * The scaling tables are printed to the standard error output too.
+ ********************************************************************************/
+
+
+#define LIFE_NO_MAIN
+#include "life.cpp"
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cmath>
+
+
+#define BENCH_DENSITY   0.35    // Probability of a live cell of the random grids
+#define BENCH_SEED      2024    // Seed of the random grids
+#define CHECK_GENERATIONS   37  // Generations of the random grids compared with HashLife
+#define CYCLE_GENERATIONS   1000003 // Generations of the cycle detection test (computed only if no cycle is found)
+#define CYCLE_GRID  "0000000000\n0000000000\n0001110000\n0000000000\n0000000000\n" \
+                    "0000000110\n0000000110\n0000000000\n0000000000\n0000000000\n"
+
+// Rules of the random grids: the rules with specialized kernels and one without
+static const char *const GOLDEN_RULES[] = {"B3/S23", "B36/S23", "B3678/S34678", "B2/S", "B1357/S1357"};
+
+
+// Options of the harness
+struct HarnessOptions
+{
+    std::string mode;
+    std::string testsDirectory = "my_tests";
+    std::vector<int> sizes = {10000};
+    int weakSide = 2048;
+    long long generations = 10;
+    std::vector<std::string> kernels;
+    std::vector<std::string> layouts = {"tiles", "rows"};
+    std::vector<int> processes;
+    // Options of every engine run (after --)
+    std::vector<std::string> lifeOptions;
+};
+
+
+// Field of a JSON line: the name and the formatted value
+typedef std::pair<std::string, std::string> Field;
+
+
+/**
+ * Splits a comma separated list.
+ *
+ * @param list The list.
+ * @return The items.
+ */
+static std::vector<std::string> splitList(const std::string &list)
+{
+    std::vector<std::string> items;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ','))
+    {
+        if (!item.empty())
+        {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+
+/**
+ * Formats a string as a JSON value.
+ *
+ * @param text The string.
+ * @return The quoted string.
+ */
+static std::string jsonString(const std::string &text)
+{
+    std::string quoted = "\"";
+    for (char c : text)
+    {
+        if (c == '"' || c == '\\')
+        {
+            quoted += '\\';
+        }
+        quoted += c;
+    }
+    return quoted + '"';
+}
+
+
+/**
+ * Formats a number as a JSON value.
+ *
+ * @param value The number.
+ * @return The number (6 significant digits).
+ */
+static std::string jsonNumber(double value)
+{
+    std::ostringstream stream;
+    stream << std::setprecision(6) << value;
+    return stream.str();
+}
+
+
+/**
+ * Prints a JSON line (first process).
+ *
+ * @param fields The fields of the object.
+ */
+static void printRecord(const std::vector<Field> &fields)
+{
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    if (rank != 0)
+    {
+        return;
+    }
+
+    std::string line = "{";
+    for (size_t i = 0; i < fields.size(); i++)
+    {
+        line += (i > 0 ? ", " : "") + jsonString(fields[i].first) + ": " + fields[i].second;
+    }
+    std::cout << line << "}" << std::endl;
+}
+
+
+/**
+ * Runs the engine once (collective).
+ *
+ * @param arguments Arguments of the engine after the program name (the file and the game time first).
+ * @param load Loads the grid into the engine (reads the file or generates a grid).
+ * @param output The printed grid without the row numbers on the first process (nullptr to print nothing).
+ * @return The measurements of the slowest process.
+ * @brief The standard output and the standard error output of the engine are captured.
+ */
+static RunStatistics runEngine(std::vector<std::string> arguments, const std::function<void(GameOfLife &)> &load,
+                               std::string *output)
+{
+    arguments.insert(arguments.begin(), "life");
+    if (output == nullptr)
+    {
+        arguments.push_back("-q");
+    }
+    std::vector<char *> argv;
+    for (std::string &argument : arguments)
+    {
+        argv.push_back(&argument[0]);
+    }
+    argv.push_back(nullptr);
+
+    std::ostringstream printed, errors;
+    std::streambuf *coutBuffer = std::cout.rdbuf(printed.rdbuf()), *cerrBuffer = std::cerr.rdbuf(errors.rdbuf());
+    RunStatistics statistics;
+    {
+        GameOfLife game(argv.size() - 1, argv.data());
+        load(game);
+        game.runSimulation();
+        statistics = game.statistics();
+    }
+    std::cout.rdbuf(coutBuffer);
+    std::cerr.rdbuf(cerrBuffer);
+
+    MPI_Allreduce(MPI_IN_PLACE, &statistics.generations, 1, MPI_LONG_LONG, MPI_MAX, MPI_COMM_WORLD);
+    MPI_Allreduce(MPI_IN_PLACE, &statistics.seconds, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+    MPI_Allreduce(MPI_IN_PLACE, &statistics.haloSeconds, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+
+    if (output != nullptr)
+    {
+        // "<row>: <cells>" lines
+        output->clear();
+        std::istringstream lines(printed.str());
+        std::string line;
+        while (std::getline(lines, line))
+        {
+            size_t separator = line.find(": ");
+            *output += (separator == std::string::npos ? line : line.substr(separator + 2)) + '\n';
+        }
+    }
+    return statistics;
+}
+
+
+/**
+ * Returns the kernels the CPU supports.
+ *
+ * @return Names of the kernels.
+ */
+static std::vector<std::string> supportedKernels()
+{
+    std::vector<std::string> kernels;
+    const std::pair<const char *, Kernel> rowKernels[] = {{"scalar", KERNEL_SCALAR}, {"avx2", KERNEL_AVX2}, {"avx512", KERNEL_AVX512}};
+    for (const auto &kernel : rowKernels)
+    {
+        if (selectRowKernel(kernel.second, Rule()) != nullptr)
+        {
+            kernels.push_back(kernel.first);
+        }
+    }
+    kernels.push_back("bits");
+    return kernels;
+}
+
+
+/**
+ * Checks whether the options of the engine can only be used by the byte kernels.
+ *
+ * @param options The options.
+ * @return The option (-g width or -a) that the bits kernel does not support, an empty string if there is none.
+ */
+static std::string byteKernelOption(const std::vector<std::string> &options)
+{
+    // Parsed like the engine parses them (grouped flags included), but quietly
+    std::vector<std::string> copies(options);
+    std::vector<char *> arguments = {const_cast<char *>("life")};
+    for (std::string &option : copies)
+    {
+        arguments.push_back(&option[0]);
+    }
+    std::string found;
+    const int errors = opterr;
+    opterr = 0;
+    optind = 0;
+    int opt;
+    while ((opt = getopt(int(arguments.size()), arguments.data(), LIFE_OPTIONS)) != -1)
+    {
+        if (opt == 'g' && std::string(optarg) != "1")
+        {
+            found = "-g " + std::string(optarg);
+        }
+        else if (opt == 'a')
+        {
+            found = "-a";
+        }
+    }
+    opterr = errors;
+    return found;
+}
+
+
+/**
+ * Joins the options of the engine.
+ *
+ * @param options The options.
+ * @return The options separated by spaces.
+ */
+static std::string joinOptions(const std::vector<std::string> &options)
+{
+    std::string joined;
+    for (const std::string &option : options)
+    {
+        joined += (joined.empty() ? "" : " ") + option;
+    }
+    return joined;
+}
+
+
+/**
+ * Compares the printed grid with the expected one (collective).
+ *
+ * @param output The printed grid (only on the first process).
+ * @param expected The expected grid (only needed on the first process).
+ * @return The result of the first process on all processes.
+ */
+static bool sameOutput(const std::string &output, const std::string &expected)
+{
+    int same = output == expected;
+    MPI_Bcast(&same, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    return same;
+}
+
+
+/**
+ * Runs the golden tests (collective).
+ *
+ * @param options Options of the harness.
+ * @return Number of failed tests.
+ * @brief Every i_<N>.txt of a case holds the grid after N generations of its input.txt. Then random
+ *  grids are computed by every kernel, layout and rule and compared with HashLife, which shares no
+ *  code with the grid engine.
+ */
+static int runGolden(const HarnessOptions &options)
+{
+    namespace fs = std::filesystem;
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    if (!fs::is_directory(options.testsDirectory))
+    {
+        if (rank == 0)
+        {
+            std::cerr << "Tests directory not found: " << options.testsDirectory << std::endl;
+        }
+        return 1;
+    }
+
+    // All processes run the cases in the same order
+    std::vector<fs::path> cases;
+    for (const auto &sizeDirectory : fs::directory_iterator(options.testsDirectory))
+    {
+        if (sizeDirectory.is_directory())
+        {
+            for (const auto &caseDirectory : fs::directory_iterator(sizeDirectory.path()))
+            {
+                if (fs::exists(caseDirectory.path() / "input.txt"))
+                {
+                    cases.push_back(caseDirectory.path());
+                }
+            }
+        }
+    }
+    std::sort(cases.begin(), cases.end());
+
+    int tests = 0, failed = 0;
+    std::string output;
+    for (const fs::path &casePath : cases)
+    {
+        std::vector<std::pair<int, fs::path>> expectations;
+        for (const auto &file : fs::directory_iterator(casePath))
+        {
+            int generations;
+            char rest;
+            if (sscanf(file.path().filename().c_str(), "i_%d.tx%c", &generations, &rest) == 2 && rest == 't')
+            {
+                expectations.emplace_back(generations, file.path());
+            }
+        }
+        std::sort(expectations.begin(), expectations.end());
+
+        const std::string input = (casePath / "input.txt").string();
+        for (const auto &expectation : expectations)
+        {
+            std::vector<std::string> arguments = {input, std::to_string(expectation.first)};
+            arguments.insert(arguments.end(), options.lifeOptions.begin(), options.lifeOptions.end());
+            RunStatistics statistics = runEngine(arguments, [&](GameOfLife &game) { game.readInputFile(input); }, &output);
+
+            std::ifstream expectedFile(expectation.second);
+            std::string expected, line;
+            while (expectedFile >> line)
+            {
+                expected += line + '\n';
+            }
+            bool passed = sameOutput(output, expected);
+            tests++;
+            failed += !passed;
+            printRecord({{"mode", jsonString("golden")}, {"case", jsonString(casePath.string())},
+                         {"generations", std::to_string(expectation.first)}, {"options", jsonString(joinOptions(options.lifeOptions))},
+                         {"passed", passed ? "true" : "false"}, {"seconds", jsonNumber(statistics.seconds)}});
+        }
+    }
+
+    // Random grids, every kernel, layout and rule against HashLife. The bits kernel is skipped if the
+    // options are only supported by the byte kernels (the engine would abort the job)
+    std::vector<std::string> kernels = supportedKernels();
+    const std::string byteOption = byteKernelOption(options.lifeOptions);
+    if (!byteOption.empty())
+    {
+        kernels.erase(std::remove(kernels.begin(), kernels.end(), "bits"), kernels.end());
+        printRecord({{"mode", jsonString("random")}, {"kernel", jsonString("bits")}, {"options", jsonString(joinOptions(options.lifeOptions))},
+                     {"skipped", jsonString("the kernel does not support " + byteOption)}});
+    }
+    const std::pair<int, int> grids[] = {{100, 100}, {257, 511}, {1000, 1000}};
+    for (const auto &grid : grids)
+    {
+        auto generate = [&](GameOfLife &game) { game.generateGrid(grid.first, grid.second, BENCH_DENSITY, BENCH_SEED); };
+        for (const std::string rule : GOLDEN_RULES)
+        {
+            std::string expected;
+            runEngine({"random", std::to_string(CHECK_GENERATIONS), "-e", "hashlife", "-b", rule}, generate, &expected);
+
+            for (const std::string &kernel : kernels)
+            {
+                for (const std::string &layout : options.layouts)
+                {
+                    std::vector<std::string> arguments = {"random", std::to_string(CHECK_GENERATIONS)};
+                    arguments.insert(arguments.end(), options.lifeOptions.begin(), options.lifeOptions.end());
+                    arguments.insert(arguments.end(), {"-k", kernel, "-d", layout, "-b", rule});
+                    RunStatistics statistics = runEngine(arguments, generate, &output);
+
+                    bool passed = sameOutput(output, expected);
+                    tests++;
+                    failed += !passed;
+                    printRecord({{"mode", jsonString("random")}, {"kernel", jsonString(kernel)}, {"layout", jsonString(layout)},
+                                 {"rule", jsonString(rule)}, {"rows", std::to_string(grid.first)}, {"cols", std::to_string(grid.second)},
+                                 {"generations", std::to_string(CHECK_GENERATIONS)}, {"options", jsonString(joinOptions(options.lifeOptions))},
+                                 {"passed", passed ? "true" : "false"}, {"seconds", jsonNumber(statistics.seconds)}});
+                }
+            }
+        }
+    }
+
+    // The byte kernels with the automatic ghost width (-g auto) and the cycle detection with checkpoints that clip
+    // the steps of a wide ghost zone (-p 4 -s 7 -g 3), unless the options fix the width or need width 1
+    kernels.erase(std::remove(kernels.begin(), kernels.end(), "bits"), kernels.end());
+    if (byteOption.empty())
+    {
+        std::vector<std::string> autoOptions(options.lifeOptions);
+        autoOptions.insert(autoOptions.end(), {"-g", "auto"});
+        for (const auto &grid : grids)
+        {
+            auto generate = [&](GameOfLife &game) { game.generateGrid(grid.first, grid.second, BENCH_DENSITY, BENCH_SEED); };
+            std::string expected;
+            runEngine({"random", std::to_string(CHECK_GENERATIONS), "-e", "hashlife"}, generate, &expected);
+            for (const std::string &kernel : kernels)
+            {
+                std::vector<std::string> arguments = {"random", std::to_string(CHECK_GENERATIONS)};
+                arguments.insert(arguments.end(), autoOptions.begin(), autoOptions.end());
+                arguments.insert(arguments.end(), {"-k", kernel});
+                RunStatistics statistics = runEngine(arguments, generate, &output);
+
+                bool passed = sameOutput(output, expected);
+                tests++;
+                failed += !passed;
+                printRecord({{"mode", jsonString("random")}, {"kernel", jsonString(kernel)}, {"rows", std::to_string(grid.first)},
+                             {"cols", std::to_string(grid.second)}, {"generations", std::to_string(CHECK_GENERATIONS)},
+                             {"options", jsonString(joinOptions(autoOptions))},
+                             {"passed", passed ? "true" : "false"}, {"seconds", jsonNumber(statistics.seconds)}});
+            }
+        }
+
+        // A blinker and a block: the run passes if it skips the periods and ends like HashLife
+        const fs::path input = fs::temp_directory_path() / "life_harness_cycle.txt";
+        const fs::path checkpoint = fs::temp_directory_path() / "life_harness_cycle.ckpt";
+        if (rank == 0)
+        {
+            std::ofstream(input) << CYCLE_GRID;
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+        auto read = [&](GameOfLife &game) { game.readInputFile(input.string()); };
+        std::string expected;
+        runEngine({input.string(), std::to_string(CYCLE_GENERATIONS), "-e", "hashlife"}, read, &expected);
+        std::vector<std::string> cycleOptions(options.lifeOptions);
+        cycleOptions.insert(cycleOptions.end(), {"-p", "4", "-s", "7", "-g", "3", "-f", checkpoint.string()});
+        for (const std::string &kernel : kernels)
+        {
+            std::vector<std::string> arguments = {input.string(), std::to_string(CYCLE_GENERATIONS)};
+            arguments.insert(arguments.end(), cycleOptions.begin(), cycleOptions.end());
+            arguments.insert(arguments.end(), {"-k", kernel});
+            RunStatistics statistics = runEngine(arguments, read, &output);
+
+            bool passed = sameOutput(output, expected) && statistics.generations < CYCLE_GENERATIONS;
+            tests++;
+            failed += !passed;
+            printRecord({{"mode", jsonString("cycle")}, {"kernel", jsonString(kernel)},
+                         {"generations", std::to_string(CYCLE_GENERATIONS)}, {"computed", std::to_string(statistics.generations)},
+                         {"options", jsonString(joinOptions(cycleOptions))},
+                         {"passed", passed ? "true" : "false"}, {"seconds", jsonNumber(statistics.seconds)}});
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+        if (rank == 0)
+        {
+            fs::remove(input);
+            fs::remove(checkpoint);
+        }
+    }
+
+    printRecord({{"mode", jsonString("summary")}, {"tests", std::to_string(tests)},
+                 {"passed", std::to_string(tests - failed)}, {"failed", std::to_string(failed)}});
+    return failed;
+}
+
+
+/**
+ * Measures one scaling series (collective).
+ *
+ * @param options Options of the harness.
+ * @param scaling "strong" (the same grid for every number of processes) or "weak" (the same tile).
+ * @param kernel The kernel.
+ * @param layout The layout.
+ * @param side Side of the grid (strong) or of the grid of one process (weak).
+ * @brief Prints a JSON line per number of processes and the table to the standard error output.
+ */
+static void runSeries(const HarnessOptions &options, const std::string &scaling, const std::string &kernel,
+                      const std::string &layout, int side)
+{
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    std::ostringstream table;
+    table << "\n" << scaling << " scaling, kernel " << kernel << ", layout " << layout << ", side " << side << "\n"
+          << std::setw(10) << "processes" << std::setw(14) << "grid" << std::setw(12) << "seconds"
+          << std::setw(12) << "halo" << std::setw(12) << "compute" << std::setw(14) << "updates/s"
+          << std::setw(10) << "speedup" << std::setw(12) << "efficiency" << "\n";
+
+    double baseSeconds = 0;
+    int baseProcesses = 0;
+    for (int processes : options.processes)
+    {
+        const int gridSide = scaling == "strong" ? side : int(std::lround(side * std::sqrt(double(processes))));
+        std::vector<std::string> arguments = {"random", std::to_string(options.generations)};
+        arguments.insert(arguments.end(), options.lifeOptions.begin(), options.lifeOptions.end());
+        arguments.insert(arguments.end(), {"-k", kernel, "-d", layout, "-n", std::to_string(processes)});
+        RunStatistics statistics = runEngine(arguments, [&](GameOfLife &game)
+        {
+            game.generateGrid(gridSide, gridSide, BENCH_DENSITY, BENCH_SEED);
+        }, nullptr);
+
+        if (baseProcesses == 0)
+        {
+            baseSeconds = statistics.seconds;
+            baseProcesses = processes;
+        }
+        const double updates = double(gridSide) * gridSide * statistics.generations / statistics.seconds;
+        // Strong: the time falls with the processes, weak: it stays the same
+        const double speedup = baseSeconds / statistics.seconds;
+        const double efficiency = scaling == "strong" ? speedup * baseProcesses / processes : speedup;
+        printRecord({{"mode", jsonString(scaling)}, {"kernel", jsonString(kernel)}, {"layout", jsonString(layout)},
+                     {"processes", std::to_string(processes)}, {"rows", std::to_string(gridSide)},
+                     {"cols", std::to_string(gridSide)}, {"generations", std::to_string(statistics.generations)},
+                     {"options", jsonString(joinOptions(options.lifeOptions))},
+                     {"seconds", jsonNumber(statistics.seconds)}, {"halo_seconds", jsonNumber(statistics.haloSeconds)},
+                     {"compute_seconds", jsonNumber(statistics.seconds - statistics.haloSeconds)},
+                     {"cell_updates_per_second", jsonNumber(updates)}, {"speedup", jsonNumber(speedup)},
+                     {"efficiency", jsonNumber(efficiency)}});
+        table << std::setw(10) << processes << std::setw(14) << (std::to_string(gridSide) + "^2")
+              << std::setw(12) << jsonNumber(statistics.seconds) << std::setw(12) << jsonNumber(statistics.haloSeconds)
+              << std::setw(12) << jsonNumber(statistics.seconds - statistics.haloSeconds) << std::setw(14) << jsonNumber(updates)
+              << std::setw(10) << jsonNumber(speedup) << std::setw(12) << jsonNumber(efficiency) << "\n";
+    }
+
+    if (rank == 0)
+    {
+        std::cerr << table.str() << std::flush;
+    }
+}
+
+
+/**
+ * Runs the benchmarks (collective).
+ *
+ * @param options Options of the harness.
+ */
+static void runBenchmark(const HarnessOptions &options)
+{
+    for (const std::string &kernel : options.kernels)
+    {
+        for (const std::string &layout : options.layouts)
+        {
+            for (int side : options.sizes)
+            {
+                runSeries(options, "strong", kernel, layout, side);
+            }
+            if (options.weakSide > 0)
+            {
+                runSeries(options, "weak", kernel, layout, options.weakSide);
+            }
+        }
+    }
+}
+
+
+/**
+ * Entry point of the harness.
+ *
+ * @param argc Number of command-line arguments.
+ * @param argv Array of command-line arguments.
+ * @return 0 if all tests passed.
+ */
+int main(int argc, char **argv)
+{
+    int threadLevel, rank, noRanks;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &threadLevel);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &noRanks);
+
+    const char *usage = "Usage: %s golden|bench [-d dir] [-s sizes] [-w side] [-g generations] [-k kernels] [-l layouts] [-n processes] [-- life options]\n";
+    if (argc < 2 || (std::string(argv[1]) != "golden" && std::string(argv[1]) != "bench"))
+    {
+        if (rank == 0)
+        {
+            fprintf(stderr, usage, argv[0]);
+        }
+        MPI_Finalize();
+        return 1;
+    }
+
+    HarnessOptions options;
+    options.mode = argv[1];
+    options.kernels = supportedKernels();
+    // Full reset of getopt, the options follow the mode
+    std::vector<char *> arguments = {argv[0]};
+    arguments.insert(arguments.end(), argv + 2, argv + argc);
+    optind = 0;
+    int opt;
+    while ((opt = getopt(int(arguments.size()), arguments.data(), "d:s:w:g:k:l:n:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'd':
+            options.testsDirectory = optarg;
+            break;
+        case 's':
+            options.sizes.clear();
+            for (const std::string &size : splitList(optarg))
+            {
+                options.sizes.push_back(atoi(size.c_str()));
+            }
+            break;
+        case 'w':
+            options.weakSide = atoi(optarg);
+            break;
+        case 'g':
+            options.generations = atoll(optarg);
+            break;
+        case 'k':
+            options.kernels = splitList(optarg);
+            break;
+        case 'l':
+            options.layouts = splitList(optarg);
+            break;
+        case 'n':
+            for (const std::string &processes : splitList(optarg))
+            {
+                options.processes.push_back(atoi(processes.c_str()));
+            }
+            break;
+        default:
+            if (rank == 0)
+            {
+                fprintf(stderr, usage, argv[0]);
+            }
+            MPI_Finalize();
+            return 1;
+        }
+    }
+    options.lifeOptions.assign(arguments.begin() + optind, arguments.end());
+
+    if (options.processes.empty())
+    {
+        for (int processes = 1; processes < noRanks; processes *= 2)
+        {
+            options.processes.push_back(processes);
+        }
+        options.processes.push_back(noRanks);
+    }
+
+    int failed = 0;
+    if (options.mode == "golden")
+    {
+        failed = runGolden(options);
+    }
+    else
+    {
+        runBenchmark(options);
+    }
+
+    MPI_Finalize();
+    return failed > 0 ? 1 : 0;
+}
@@ -19,11 +19,11 @@ fi
 # number of steps
 num_of_steps=$2
 
-# calculate number of rows (CPUs)
-rows_count=$(wc -l < "$input_file")
+# number of processes (the grid is split into 2D tiles, so any count works), default number of CPUs
+num_of_procs=${3:-$(nproc)}
 
 # run program
-mpirun --oversubscribe --prefix /usr/local/share/OpenMPI -np $rows_count life "$input_file" "$num_of_steps"
+mpirun --oversubscribe --prefix /usr/local/share/OpenMPI -np $num_of_procs life "$input_file" "$num_of_steps"
 
 # clean up
 rm -f life
\ No newline at end of file